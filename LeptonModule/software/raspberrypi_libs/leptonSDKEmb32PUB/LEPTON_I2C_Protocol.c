@@ -67,12 +67,20 @@
 #include "LEPTON_ErrorCodes.h"
 #include "LEPTON_I2C_Protocol.h"
 #include "LEPTON_I2C_Reg.h"
+#include "LEPTON_SYS.h"
+#include "LEPTON_OEM.h"
 #include "crc16.h"
 
+#include <string.h>
+#include <time.h>
+
 /******************************************************************************/
 /** LOCAL DEFINES                                                            **/
 /******************************************************************************/
 
+/* Command ID without the GET/SET/RUN type bits
+*/
+#define LEP_I2C_COMMAND_BASE(id)    ((id) & ~0x0003)
 
 /******************************************************************************/
 /** LOCAL TYPE DEFINITIONS                                                   **/
@@ -82,10 +90,46 @@
 /** PRIVATE DATA DECLARATIONS                                                **/
 /******************************************************************************/
 
+/* Short commands finish in well under a millisecond, so they start polling
+** fast; FFC takes a few hundred milliseconds and backs off further.
+*/
+static LEP_I2C_POLL_POLICY_T pollPolicy[LEP_I2C_END_POLL_CLASS] =
+{
+    {  50,  1000, LEPTON_I2C_POLL_DEADLINE_MS },    /* READY */
+    {  50,  1000, LEPTON_I2C_POLL_DEADLINE_MS },    /* GET */
+    {  50,  1000, LEPTON_I2C_POLL_DEADLINE_MS },    /* SET */
+    { 100,  5000, LEPTON_I2C_POLL_DEADLINE_MS },    /* RUN */
+    { 1000, 20000, 5000 }                           /* LONG */
+};
+
+/* Plain counters, written by the thread driving the port. Other threads
+** must not read them while a command may run (the 64-bit fields tear on
+** 32-bit ARM); the CCI worker copies them between commands
+*/
+static LEP_I2C_POLL_STATS_T pollStats[LEP_I2C_END_POLL_CLASS];
+
+/* Largest block buffer transfer, 0 = the whole attribute in one transfer
+*/
+static LEP_UINT16 blockTransferWords = 0;
+
 /******************************************************************************/
 /** PRIVATE FUNCTION DECLARATIONS                                            **/
 /******************************************************************************/
 
+static LEP_RESULT LEP_I2C_WaitNotBusy(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
+                                      LEP_I2C_POLL_CLASS_E pollClass,
+                                      LEP_UINT16 *statusReg);
+
+static LEP_I2C_POLL_CLASS_E LEP_I2C_PollClassForRun(LEP_COMMAND_ID commandID);
+
+static LEP_RESULT LEP_I2C_ReadBlock(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
+                                    LEP_ATTRIBUTE_T_PTR attributePtr,
+                                    LEP_UINT16 attributeWordLength);
+
+static LEP_RESULT LEP_I2C_WriteBlock(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
+                                     LEP_ATTRIBUTE_T_PTR attributePtr,
+                                     LEP_UINT16 attributeWordLength);
+
 /******************************************************************************/
 /** EXPORTED PUBLIC DATA                                                     **/
 /******************************************************************************/
@@ -94,6 +138,73 @@
 /** EXPORTED PUBLIC FUNCTIONS                                                **/
 /******************************************************************************/
 
+LEP_RESULT LEP_I2C_SetPollPolicy(LEP_I2C_POLL_CLASS_E pollClass,
+                                 const LEP_I2C_POLL_POLICY_T *policyPtr)
+{
+   if(pollClass >= LEP_I2C_END_POLL_CLASS)
+   {
+      return(LEP_RANGE_ERROR);
+   }
+   if(policyPtr == NULL)
+   {
+      return(LEP_BAD_ARG_POINTER_ERROR);
+   }
+   pollPolicy[pollClass] = *policyPtr;
+   if(pollPolicy[pollClass].maxDelayUs < pollPolicy[pollClass].initialDelayUs)
+   {
+      pollPolicy[pollClass].maxDelayUs = pollPolicy[pollClass].initialDelayUs;
+   }
+
+   return(LEP_OK);
+}
+
+LEP_RESULT LEP_I2C_GetPollPolicy(LEP_I2C_POLL_CLASS_E pollClass,
+                                 LEP_I2C_POLL_POLICY_T_PTR policyPtr)
+{
+   if(pollClass >= LEP_I2C_END_POLL_CLASS)
+   {
+      return(LEP_RANGE_ERROR);
+   }
+   if(policyPtr == NULL)
+   {
+      return(LEP_BAD_ARG_POINTER_ERROR);
+   }
+   *policyPtr = pollPolicy[pollClass];
+
+   return(LEP_OK);
+}
+
+LEP_RESULT LEP_I2C_GetPollStats(LEP_I2C_POLL_CLASS_E pollClass,
+                                LEP_I2C_POLL_STATS_T_PTR statsPtr)
+{
+   if(pollClass >= LEP_I2C_END_POLL_CLASS)
+   {
+      return(LEP_RANGE_ERROR);
+   }
+   if(statsPtr == NULL)
+   {
+      return(LEP_BAD_ARG_POINTER_ERROR);
+   }
+   *statsPtr = pollStats[pollClass];
+
+   return(LEP_OK);
+}
+
+void LEP_I2C_ResetPollStats(void)
+{
+   memset(pollStats, 0, sizeof(pollStats));
+}
+
+void LEP_I2C_SetBlockTransferWords(LEP_UINT16 maxWords)
+{
+   blockTransferWords = maxWords;
+}
+
+LEP_UINT16 LEP_I2C_GetBlockTransferWords(void)
+{
+   return(blockTransferWords);
+}
+
 
 LEP_RESULT LEP_I2C_OpenPort(LEP_UINT16 portID,
                             LEP_UINT16 *baudRateInkHz,
@@ -165,7 +276,6 @@ LEP_RESULT LEP_I2C_GetAttribute(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
     LEP_RESULT result;
     LEP_UINT16 statusReg;
     LEP_INT16 statusCode;
-    LEP_UINT32 done;
     LEP_UINT16 crcExpected, crcActual;
 
     /* Implement the Lepton TWI READ Protocol
@@ -175,22 +285,13 @@ LEP_RESULT LEP_I2C_GetAttribute(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
     ** reports NOT BUSY.
     */ 
 
-    do
+    result = LEP_I2C_WaitNotBusy( portDescPtr,
+                                  LEP_I2C_POLL_READY,
+                                  &statusReg );
+    if(result != LEP_OK)
     {
-        /* Read the Status REGISTER and peek at the BUSY Bit
-        */ 
-        result = LEP_I2C_MasterReadData( portDescPtr->portID,
-                                         portDescPtr->deviceAddress,
-                                         LEP_I2C_STATUS_REG,
-                                         &statusReg,
-                                         1 );
-        if(result != LEP_OK)
-        {
-           return(result);
-        }
-        done = (statusReg & LEP_I2C_STATUS_BUSY_BIT_MASK)? 0: 1;
-
-    }while( !done );
+       return(result);
+    }
 
     /* Set the Lepton's DATA LENGTH REGISTER first to inform the
     ** Lepton Camera how many 16-bit DATA words we want to read.
@@ -221,23 +322,13 @@ LEP_RESULT LEP_I2C_GetAttribute(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
     ** polling the statusReg REGISTER BUSY Bit until it reports NOT
     ** BUSY.
     */ 
-    do
+    result = LEP_I2C_WaitNotBusy( portDescPtr,
+                                  LEP_I2C_POLL_GET,
+                                  &statusReg );
+    if(result != LEP_OK)
     {
-        /* Read the statusReg REGISTER and peek at the BUSY Bit
-        */ 
-        result = LEP_I2C_MasterReadData( portDescPtr->portID,
-                                         portDescPtr->deviceAddress,
-                                         LEP_I2C_STATUS_REG,
-                                         &statusReg,
-                                         1 );
-
-        if(result != LEP_OK)
-        {
-           return(result);
-        }
-        done = (statusReg & LEP_I2C_STATUS_BUSY_BIT_MASK)? 0: 1;
-
-    }while( !done );
+       return(result);
+    }
     
 
     /* Check statusReg word for Errors?
@@ -250,7 +341,7 @@ LEP_RESULT LEP_I2C_GetAttribute(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
 
     /* If NO Errors then READ the DATA from the DATA REGISTER(s)
     */ 
-    if( attributeWordLength <= 16 )
+    if( attributeWordLength <= LEP_I2C_DATA_REG_WORDS )
     {
         /* Read from the DATA Registers - always start from DATA 0
         ** Little Endean
@@ -261,15 +352,15 @@ LEP_RESULT LEP_I2C_GetAttribute(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
                                         attributePtr,
                                         attributeWordLength );
     }
-    else if( attributeWordLength <= 1024 )
+    else if( attributeWordLength <= LEP_I2C_BLOCK_BUFFER_WORDS )
     {
         /* Read from the DATA Block Buffer
         */ 
-      result = LEP_I2C_MasterReadData(portDescPtr->portID,
-                                      portDescPtr->deviceAddress,
-                                      LEP_I2C_DATA_BUFFER_0,
-                                      attributePtr,
-                                      attributeWordLength );
+        result = LEP_I2C_ReadBlock(portDescPtr, attributePtr, attributeWordLength);
+    }
+    else
+    {
+        return(LEP_RANGE_ERROR);
     }
     if(result == LEP_OK && attributeWordLength > 0)
     {
@@ -303,8 +394,6 @@ LEP_RESULT LEP_I2C_SetAttribute(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
     LEP_RESULT result;
     LEP_UINT16 statusReg;
     LEP_INT16 statusCode;
-    LEP_UINT32 done;
-    LEP_UINT16 timeoutCount = LEPTON_I2C_COMMAND_BUSY_WAIT_COUNT;
 
     /* Implement the Lepton TWI WRITE Protocol
     */
@@ -312,35 +401,19 @@ LEP_RESULT LEP_I2C_SetAttribute(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
     ** command by polling the STATUS REGISTER BUSY Bit until it
     ** reports NOT BUSY.
     */ 
-    do
+    result = LEP_I2C_WaitNotBusy( portDescPtr,
+                                  LEP_I2C_POLL_READY,
+                                  &statusReg );
+    if(result != LEP_OK)
     {
-        /* Read the Status REGISTER and peek at the BUSY Bit
-        */ 
-        result = LEP_I2C_MasterReadData( portDescPtr->portID,
-                                         portDescPtr->deviceAddress,
-                                         LEP_I2C_STATUS_REG,
-                                         &statusReg,
-                                         1 );
-        if(result != LEP_OK)
-        {
-           return(result);
-        }
-        done = (statusReg & LEP_I2C_STATUS_BUSY_BIT_MASK)? 0: 1;
-        /* Add timout check */
-        if( timeoutCount-- == 0 )
-        {
-            /* Timed out waiting for command busy to go away
-            */ 
-          return(LEP_TIMEOUT_ERROR);
-
-        }
-    }while( !done );
+       return(result);
+    }
 
     if( result == LEP_OK )
     {
         /* Now WRITE the DATA to the DATA REGISTER(s)
         */ 
-        if( attributeWordLength <= 16 )
+        if( attributeWordLength <= LEP_I2C_DATA_REG_WORDS )
         {
             /* WRITE to the DATA Registers - always start from DATA 0
             */ 
@@ -350,16 +423,11 @@ LEP_RESULT LEP_I2C_SetAttribute(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
                                              attributePtr,
                                              attributeWordLength );
         }
-        else if( attributeWordLength <= 1024 )
+        else if( attributeWordLength <= LEP_I2C_BLOCK_BUFFER_WORDS )
         {
             /* WRITE to the DATA Block Buffer
             */     
-            result = LEP_I2C_MasterWriteData(portDescPtr->portID,
-                                             portDescPtr->deviceAddress,
-                                             LEP_I2C_DATA_BUFFER_0,
-                                             attributePtr,
-                                             attributeWordLength );
-
+            result = LEP_I2C_WriteBlock(portDescPtr, attributePtr, attributeWordLength);
         }
         else
             result = LEP_RANGE_ERROR;
@@ -392,22 +460,13 @@ LEP_RESULT LEP_I2C_SetAttribute(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
                 ** polling the statusReg REGISTER BUSY Bit until it reports NOT
                 ** BUSY.
                 */ 
-                do
+                result = LEP_I2C_WaitNotBusy( portDescPtr,
+                                              LEP_I2C_POLL_SET,
+                                              &statusReg );
+                if(result != LEP_OK)
                 {
-                    /* Read the statusReg REGISTER and peek at the BUSY Bit
-                    */ 
-                    result = LEP_I2C_MasterReadData( portDescPtr->portID,
-                                                     portDescPtr->deviceAddress,
-                                                     LEP_I2C_STATUS_REG,
-                                                     &statusReg,
-                                                     1 );
-                    if(result != LEP_OK)
-                    {
-                       return(result);
-                    }
-                    done = (statusReg & LEP_I2C_STATUS_BUSY_BIT_MASK)? 0: 1;
-
-                }while( !done );
+                   return(result);
+                }
 
                     /* Check statusReg word for Errors?
                    */ 
@@ -434,8 +493,6 @@ LEP_RESULT LEP_I2C_RunCommand(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
     LEP_RESULT result;
     LEP_UINT16 statusReg;
     LEP_INT16 statusCode;
-    LEP_UINT32 done;
-    LEP_UINT16 timeoutCount = LEPTON_I2C_COMMAND_BUSY_WAIT_COUNT;
 
     /* Implement the Lepton TWI WRITE Protocol
     */
@@ -443,27 +500,13 @@ LEP_RESULT LEP_I2C_RunCommand(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
     ** command by polling the STATUS REGISTER BUSY Bit until it
     ** reports NOT BUSY.
     */ 
-    do
+    result = LEP_I2C_WaitNotBusy( portDescPtr,
+                                  LEP_I2C_POLL_READY,
+                                  &statusReg );
+    if(result != LEP_OK)
     {
-        /* Read the Status REGISTER and peek at the BUSY Bit
-        */ 
-        result = LEP_I2C_MasterReadRegister( portDescPtr->portID,
-                                             portDescPtr->deviceAddress,
-                                             LEP_I2C_STATUS_REG,
-                                             &statusReg);
-        if(result != LEP_OK)
-        {
-            return(result);
-        }
-        done = (statusReg & LEP_I2C_STATUS_BUSY_BIT_MASK)? 0: 1;
-        /* Add timout check */
-        if( timeoutCount-- == 0 )
-        {
-            /* Timed out waiting for command busy to go away
-            */ 
-
-        }
-    }while( !done );
+       return(result);
+    }
 
     if( result == LEP_OK )
     {
@@ -489,22 +532,13 @@ LEP_RESULT LEP_I2C_RunCommand(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
                 ** polling the statusReg REGISTER BUSY Bit until it reports NOT
                 ** BUSY.
                 */ 
-                do
+                result = LEP_I2C_WaitNotBusy( portDescPtr,
+                                              LEP_I2C_PollClassForRun(commandID),
+                                              &statusReg );
+                if(result != LEP_OK)
                 {
-                    /* Read the statusReg REGISTER and peek at the BUSY Bit
-                    */ 
-                    result = LEP_I2C_MasterReadRegister( portDescPtr->portID,
-                                                         portDescPtr->deviceAddress,
-                                                         LEP_I2C_STATUS_REG,
-                                                         &statusReg);
-                    if(result != LEP_OK)
-                    {
-                        return(result);
-                    }
-                    done = (statusReg & LEP_I2C_STATUS_BUSY_BIT_MASK)? 0: 1;
-                    /* Timeout? */
-
-                }while( !done );
+                   return(result);
+                }
 
                 statusCode = (statusReg >> 8) ? ((statusReg >> 8) | 0xFF00) : 0;
                 if(statusCode)
@@ -566,11 +600,11 @@ LEP_RESULT LEP_I2C_DirectWriteBuffer(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
 
    /* WRITE to the DATA Block Buffer
    */     
-   result = LEP_I2C_MasterWriteData(portDescPtr->portID,
-                                    portDescPtr->deviceAddress,
-                                    LEP_I2C_DATA_BUFFER_0,
-                                    attributePtr,
-                                    attributeWordLength );
+   if( attributeWordLength > LEP_I2C_BLOCK_BUFFER_WORDS )
+   {
+      return(LEP_RANGE_ERROR);
+   }
+   result = LEP_I2C_WriteBlock(portDescPtr, attributePtr, attributeWordLength);
 
   
 
@@ -594,4 +628,148 @@ LEP_RESULT LEP_I2C_DirectWriteRegister(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
 /** PRIVATE MODULE FUNCTIONS                                                 **/
 /******************************************************************************/
 
+static LEP_UINT64 LEP_I2C_NowUs(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return((LEP_UINT64)ts.tv_sec * 1000000u + (LEP_UINT64)(ts.tv_nsec / 1000));
+}
+
+/* Poll the STATUS REGISTER until the BUSY Bit clears, backing off between
+** reads per the class policy. statusReg holds the last value read.
+*/
+static LEP_RESULT LEP_I2C_WaitNotBusy(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
+                                      LEP_I2C_POLL_CLASS_E pollClass,
+                                      LEP_UINT16 *statusReg)
+{
+   const LEP_I2C_POLL_POLICY_T *policy = &pollPolicy[pollClass];
+   LEP_I2C_POLL_STATS_T *stats = &pollStats[pollClass];
+   LEP_RESULT result;
+   LEP_UINT64 start = LEP_I2C_NowUs();
+   LEP_UINT64 deadline = start + (LEP_UINT64)policy->deadlineMs * 1000u;
+   LEP_UINT64 now;
+   LEP_UINT32 delayUs = policy->initialDelayUs;
+   LEP_UINT32 polls = 0;
+   struct timespec pause;
+
+   for(;;)
+   {
+      result = LEP_I2C_MasterReadData( portDescPtr->portID,
+                                       portDescPtr->deviceAddress,
+                                       LEP_I2C_STATUS_REG,
+                                       statusReg,
+                                       1 );
+      polls++;
+      now = LEP_I2C_NowUs();
+      if(result != LEP_OK || !(*statusReg & LEP_I2C_STATUS_BUSY_BIT_MASK))
+      {
+         break;
+      }
+      if(now >= deadline)
+      {
+         stats->timeouts++;
+         result = LEP_TIMEOUT_ERROR;
+         break;
+      }
+
+      /* Never sleep past the deadline; the last read lands on it
+      */
+      if(now + delayUs > deadline)
+      {
+         delayUs = (LEP_UINT32)(deadline - now);
+      }
+      pause.tv_sec = delayUs / 1000000u;
+      pause.tv_nsec = (long)(delayUs % 1000000u) * 1000;
+      nanosleep(&pause, NULL);
+
+      delayUs = (delayUs < policy->maxDelayUs / 2) ? delayUs * 2 : policy->maxDelayUs;
+      if(delayUs == 0)
+      {
+         delayUs = 1;
+      }
+   }
+
+   stats->waits++;
+   stats->polls += polls;
+   stats->lastPolls = polls;
+   if(polls > stats->maxPolls)
+   {
+      stats->maxPolls = polls;
+   }
+   stats->lastWaitUs = (LEP_UINT32)(now - start);
+   if(stats->lastWaitUs > stats->maxWaitUs)
+   {
+      stats->maxWaitUs = stats->lastWaitUs;
+   }
+
+   return(result);
+}
+
+static LEP_I2C_POLL_CLASS_E LEP_I2C_PollClassForRun(LEP_COMMAND_ID commandID)
+{
+   LEP_UINT16 base = LEP_I2C_COMMAND_BASE(commandID);
+
+   if(base == LEP_I2C_COMMAND_BASE(FLR_CID_SYS_RUN_FFC) ||
+      base == LEP_I2C_COMMAND_BASE(LEP_CID_OEM_FFC_NORMALIZATION_TARGET) ||
+      base == LEP_I2C_COMMAND_BASE(LEP_CID_OEM_REBOOT))
+   {
+      return(LEP_I2C_POLL_LONG);
+   }
+   return(LEP_I2C_POLL_RUN);
+}
+
+/* Block data buffer transfers: one I2C transfer for the whole attribute,
+** or pieces of blockTransferWords for masters with a transfer size limit.
+*/
+static LEP_RESULT LEP_I2C_ReadBlock(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
+                                    LEP_ATTRIBUTE_T_PTR attributePtr,
+                                    LEP_UINT16 attributeWordLength)
+{
+   LEP_RESULT result = LEP_OK;
+   LEP_UINT16 offset = 0;
+   LEP_UINT16 words;
+
+   while(result == LEP_OK && offset < attributeWordLength)
+   {
+      words = attributeWordLength - offset;
+      if(blockTransferWords != 0 && words > blockTransferWords)
+      {
+         words = blockTransferWords;
+      }
+      result = LEP_I2C_MasterReadData(portDescPtr->portID,
+                                      portDescPtr->deviceAddress,
+                                      LEP_I2C_DATA_BUFFER_0 + (offset << 1),
+                                      attributePtr + offset,
+                                      words );
+      offset += words;
+   }
+
+   return(result);
+}
 
+static LEP_RESULT LEP_I2C_WriteBlock(LEP_CAMERA_PORT_DESC_T_PTR portDescPtr,
+                                     LEP_ATTRIBUTE_T_PTR attributePtr,
+                                     LEP_UINT16 attributeWordLength)
+{
+   LEP_RESULT result = LEP_OK;
+   LEP_UINT16 offset = 0;
+   LEP_UINT16 words;
+
+   while(result == LEP_OK && offset < attributeWordLength)
+   {
+      words = attributeWordLength - offset;
+      if(blockTransferWords != 0 && words > blockTransferWords)
+      {
+         words = blockTransferWords;
+      }
+      result = LEP_I2C_MasterWriteData(portDescPtr->portID,
+                                       portDescPtr->deviceAddress,
+                                       LEP_I2C_DATA_BUFFER_0 + (offset << 1),
+                                       attributePtr + offset,
+                                       words );
+      offset += words;
+   }
+
+   return(result);
+}
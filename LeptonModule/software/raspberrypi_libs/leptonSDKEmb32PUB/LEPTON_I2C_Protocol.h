@@ -77,9 +77,18 @@ extern "C"
 /** EXPORTED DEFINES                                                         **/
 /******************************************************************************/
 
-    /* Timeout count to wait for I2C command to complete
+    /* Busy-bit polling: the first status read is immediate, then the
+    ** delay between reads doubles from initialDelayUs up to maxDelayUs
+    ** until the camera reports NOT BUSY or deadlineMs of wall-clock time
+    ** has passed (LEP_TIMEOUT_ERROR).
     */ 
-    #define LEPTON_I2C_COMMAND_BUSY_WAIT_COUNT              1000
+    #define LEPTON_I2C_POLL_DEADLINE_MS                     1000
+
+    /* Attributes up to LEP_I2C_DATA_REG_WORDS move through DATA 0-15,
+    ** larger ones through the block data buffer
+    */ 
+    #define LEP_I2C_DATA_REG_WORDS                          16
+    #define LEP_I2C_BLOCK_BUFFER_WORDS                      1024
 
 /******************************************************************************/
 /** EXPORTED TYPE DEFINITIONS                                                **/
@@ -94,6 +103,40 @@ extern "C"
 
     }LEP_I2C_COMMAND_STATUS_E, *LEP_I2C_COMMAND_STATUS_E_PTR;
 
+    /* Which busy wait a poll belongs to; each class has its own policy
+    ** and statistics.
+    */
+    typedef enum LEP_I2C_POLL_CLASS_TAG
+    {
+        LEP_I2C_POLL_READY = 0,     /* idle check before issuing a command */
+        LEP_I2C_POLL_GET,           /* completion of a GET */
+        LEP_I2C_POLL_SET,           /* completion of a SET */
+        LEP_I2C_POLL_RUN,           /* completion of a RUN */
+        LEP_I2C_POLL_LONG,          /* FFC and reboot RUN commands */
+        LEP_I2C_END_POLL_CLASS
+
+    }LEP_I2C_POLL_CLASS_E, *LEP_I2C_POLL_CLASS_E_PTR;
+
+    typedef struct LEP_I2C_POLL_POLICY_TAG
+    {
+        LEP_UINT32 initialDelayUs;
+        LEP_UINT32 maxDelayUs;
+        LEP_UINT32 deadlineMs;
+
+    }LEP_I2C_POLL_POLICY_T, *LEP_I2C_POLL_POLICY_T_PTR;
+
+    typedef struct LEP_I2C_POLL_STATS_TAG
+    {
+        LEP_UINT32 waits;           /* busy waits performed */
+        LEP_UINT32 polls;           /* status register reads, all waits */
+        LEP_UINT32 maxPolls;        /* most reads in one wait */
+        LEP_UINT32 lastPolls;       /* reads in the latest wait */
+        LEP_UINT32 timeouts;        /* waits that hit the deadline */
+        LEP_UINT32 maxWaitUs;       /* longest wait, microseconds */
+        LEP_UINT32 lastWaitUs;
+
+    }LEP_I2C_POLL_STATS_T, *LEP_I2C_POLL_STATS_T_PTR;
+
 /******************************************************************************/
 /** EXPORTED PUBLIC DATA                                                     **/
 /******************************************************************************/
@@ -107,6 +150,25 @@ extern "C"
     LEP_RESULT LEP_I2C_SetCommandRegister(LEP_COMMAND_ID commandID, 
                                           LEP_UINT16 *transactionStatus);
 
+    extern LEP_RESULT LEP_I2C_SetPollPolicy(LEP_I2C_POLL_CLASS_E pollClass,
+                                            const LEP_I2C_POLL_POLICY_T *policyPtr);
+
+    extern LEP_RESULT LEP_I2C_GetPollPolicy(LEP_I2C_POLL_CLASS_E pollClass,
+                                            LEP_I2C_POLL_POLICY_T_PTR policyPtr);
+
+    extern LEP_RESULT LEP_I2C_GetPollStats(LEP_I2C_POLL_CLASS_E pollClass,
+                                           LEP_I2C_POLL_STATS_T_PTR statsPtr);
+
+    extern void LEP_I2C_ResetPollStats(void);
+
+    /* Splits block data buffer transfers into pieces of at most maxWords
+    ** for I2C masters with a transfer size limit; 0 (default) sends each
+    ** attribute as a single transfer.
+    */
+    extern void LEP_I2C_SetBlockTransferWords(LEP_UINT16 maxWords);
+
+    extern LEP_UINT16 LEP_I2C_GetBlockTransferWords(void);
+
     extern LEP_RESULT LEP_I2C_OpenPort(LEP_UINT16 portID,
                                        LEP_UINT16 *baudRateInkHz,
                                        LEP_UINT8 *deviceAddress);
@@ -54,6 +54,9 @@
 #include <stdlib.h>
 
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include <errno.h>
 
@@ -76,6 +79,11 @@ const LEP_INT32 VALUE_SIZE_BYTES = 2;
 float clk_rate;
 const LEP_INT32 comm_timeout_ms = 500;
 
+/* Largest single transfer: the whole block data buffer (both halves)
+*/
+#define RASPI_I2C_MAX_DATA_BYTES   2048
+#define RASPI_I2C_NUM_PORTS        2
+
 /******************************************************************************/
 /** LOCAL TYPE DEFINITIONS                                                   **/
 /******************************************************************************/
@@ -84,10 +92,49 @@ const LEP_INT32 comm_timeout_ms = 500;
 /** PRIVATE DATA DECLARATIONS                                                **/
 /******************************************************************************/
 
+/* Per-port transfer buffers, so register accesses never touch the heap.
+** Each port is only ever driven by one thread at a time.
+*/
+static LEP_UINT8 txBuffer[RASPI_I2C_NUM_PORTS][2 + RASPI_I2C_MAX_DATA_BYTES];
+static LEP_UINT8 rxBuffer[RASPI_I2C_NUM_PORTS][RASPI_I2C_MAX_DATA_BYTES];
+
 /******************************************************************************/
 /** PRIVATE FUNCTION DECLARATIONS                                            **/
 /******************************************************************************/
 
+static int raspi_device(LEP_UINT16 portID);
+
+static LEP_RESULT raspi_MasterInit(LEP_UINT16 portID,
+                                   LEP_UINT16 *BaudRate);
+static LEP_RESULT raspi_MasterClose(void);
+static LEP_RESULT raspi_MasterReadData(LEP_UINT16 portID,
+                                       LEP_UINT8 deviceAddress,
+                                       LEP_UINT16 regAddress,
+                                       LEP_UINT16 *readDataPtr,
+                                       LEP_UINT16 wordsToRead,
+                                       LEP_UINT16 *numWordsRead,
+                                       LEP_UINT16 *status);
+static LEP_RESULT raspi_MasterWriteData(LEP_UINT16 portID,
+                                        LEP_UINT8 deviceAddress,
+                                        LEP_UINT16 regAddress,
+                                        LEP_UINT16 *writeDataPtr,
+                                        LEP_UINT16 wordsToWrite,
+                                        LEP_UINT16 *numWordsWritten,
+                                        LEP_UINT16 *status);
+
+/* /dev/i2c-N through the kernel i2c-dev driver
+*/
+static const DEV_I2C_BACKEND_T raspiBackend =
+{
+   "raspi",
+   raspi_MasterInit,
+   raspi_MasterClose,
+   raspi_MasterReadData,
+   raspi_MasterWriteData
+};
+
+static const DEV_I2C_BACKEND_T *i2cBackend = &raspiBackend;
+
 /******************************************************************************/
 /** EXPORTED PUBLIC DATA                                                     **/
 /******************************************************************************/
@@ -111,8 +158,8 @@ const LEP_INT32 comm_timeout_ms = 500;
  * 
  * @return LEP_RESULT  0 if all goes well, errno otherwise
  */
-LEP_RESULT DEV_I2C_MasterInit(LEP_UINT16 portID, 
-                              LEP_UINT16 *BaudRate)
+static LEP_RESULT raspi_MasterInit(LEP_UINT16 portID, 
+                                   LEP_UINT16 *BaudRate)
 {
     LEP_RESULT result = LEP_OK;
    int raspi_result;
@@ -158,7 +205,7 @@ LEP_RESULT DEV_I2C_MasterInit(LEP_UINT16 portID,
  * 
  * @return LEP_RESULT  0 if all goes well, errno otherwise.
  */
-LEP_RESULT DEV_I2C_MasterClose()
+static LEP_RESULT raspi_MasterClose(void)
 {
     LEP_RESULT result = LEP_OK;
 
@@ -186,77 +233,73 @@ LEP_RESULT DEV_I2C_MasterReset(void )
     return(result);
 }
 
-LEP_RESULT DEV_I2C_MasterReadData(LEP_UINT16  portID,               // User-defined port ID
-                                  LEP_UINT8   deviceAddress,        // Lepton Camera I2C Device Address
-                                  LEP_UINT16  regAddress,           // Lepton Register Address
-                                  LEP_UINT16 *readDataPtr,          // Read DATA buffer pointer
-                                  LEP_UINT16  wordsToRead,          // Number of 16-bit words to Read
-                                  LEP_UINT16 *numWordsRead,         // Number of 16-bit words actually Read
-                                  LEP_UINT16 *status                // Transaction Status
-                                 )
+static LEP_RESULT raspi_MasterReadData(LEP_UINT16  portID,               // User-defined port ID
+                                       LEP_UINT8   deviceAddress,        // Lepton Camera I2C Device Address
+                                       LEP_UINT16  regAddress,           // Lepton Register Address
+                                       LEP_UINT16 *readDataPtr,          // Read DATA buffer pointer
+                                       LEP_UINT16  wordsToRead,          // Number of 16-bit words to Read
+                                       LEP_UINT16 *numWordsRead,         // Number of 16-bit words actually Read
+                                       LEP_UINT16 *status                // Transaction Status
+                                      )
 {
     LEP_RESULT result = LEP_OK;
 
     /* Place Device-Specific Interface here
     */ 
    int raspi_result;
-   LEP_UINT16 bytesToWrite = ADDRESS_SIZE_BYTES;
    LEP_UINT16 bytesToRead = wordsToRead << 1;
-   LEP_UINT16 bytesActuallyWritten = 0;
    LEP_UINT16 bytesActuallyRead = 0;
    LEP_UINT16 wordsActuallyRead = 0;
-   LEP_UINT8* txdata = (LEP_UINT8*)malloc(sizeof(LEP_UINT8)*ADDRESS_SIZE_BYTES);
-   LEP_UINT8* rxdata = (LEP_UINT8*)malloc(sizeof(LEP_UINT8)*bytesToRead);
-   LEP_UINT16 *dataPtr;
+   LEP_UINT8* txdata = txBuffer[portID ? 1 : 0];
+   LEP_UINT8* rxdata = rxBuffer[portID ? 1 : 0];
    LEP_UINT16 *writePtr;
+   LEP_UINT8 *bytePtr;
+   struct i2c_msg msgs[2];
+   struct i2c_rdwr_ioctl_data xfer;
 
-   *(LEP_UINT16*)txdata = REVERSE_ENDIENESS_UINT16(regAddress);
-
-   //raspi_result = aa_i2c_write_read(handle, deviceAddress, AA_I2C_NO_FLAGS, 
-   //            bytesToWrite, txdata, &bytesActuallyWritten, //write params
-   //            bytesToRead, rxdata, &bytesActuallyRead); //read params
-
-   //DONE: here we do a raspi raspi_i2c_write_read
-   //this means writing the register, then reading bytes!
-   int leptonDevice;
-   if(portID) {
-	leptonDevice = leptonDevice1;
-   } else {
-	leptonDevice = leptonDevice0;
+   *numWordsRead = 0;
+   if(bytesToRead > RASPI_I2C_MAX_DATA_BYTES)
+   {
+      return(LEP_ERROR_I2C_BUFFER_OVERFLOW);
    }
 
-   int writeValue = write(leptonDevice, txdata, bytesToWrite);
-   if(writeValue < 0) {
-	//we have error!
+   txdata[0] = (LEP_UINT8)(regAddress >> 8);
+   txdata[1] = (LEP_UINT8)(regAddress & 0xFF);
+
+   /* Register address write and data read as one combined transaction
+   ** (repeated start): one syscall instead of a write() and a read().
+   ** The address is the one DEV_I2C_MasterInit bound with I2C_SLAVE.
+   */
+   msgs[0].addr  = LEP_I2C_DEVICE_ADDRESS;
+   msgs[0].flags = 0;
+   msgs[0].len   = ADDRESS_SIZE_BYTES;
+   msgs[0].buf   = txdata;
+   msgs[1].addr  = LEP_I2C_DEVICE_ADDRESS;
+   msgs[1].flags = I2C_M_RD;
+   msgs[1].len   = bytesToRead;
+   msgs[1].buf   = rxdata;
+   xfer.msgs  = msgs;
+   xfer.nmsgs = 2;
+
+   if(ioctl(raspi_device(portID), I2C_RDWR, &xfer) != 2) {
 	bytesActuallyRead = 0;
 	raspi_result = -1;
    } else {
-
-   	int readValue = read(leptonDevice, rxdata, bytesToRead);
-
-	if(readValue < 0) {
-		bytesActuallyRead = 0;
-		raspi_result = -1;
-	} else {
-		bytesActuallyRead = readValue;
-		raspi_result = LEP_OK;
-	}
+	bytesActuallyRead = bytesToRead;
+	raspi_result = LEP_OK;
    }
 
    wordsActuallyRead = (LEP_UINT16)(bytesActuallyRead >> 1);
    *numWordsRead = wordsActuallyRead;
 
-   dataPtr = (LEP_UINT16*)&rxdata[0];
+   /* Camera sends big-endian words
+   */
+   bytePtr = rxdata;
    writePtr = readDataPtr;
    while(wordsActuallyRead--){
-      *writePtr++ = REVERSE_ENDIENESS_UINT16(*dataPtr);
-      dataPtr++;
+      *writePtr++ = (LEP_UINT16)((bytePtr[0] << 8) | bytePtr[1]);
+      bytePtr += 2;
    }
-   free(txdata);
-   free(rxdata);
-
-   LEP_UINT8* byteData = (LEP_UINT8*)readDataPtr;
-
 
    if(raspi_result != 0 || bytesActuallyRead != bytesToRead)
    {
@@ -269,46 +312,42 @@ LEP_RESULT DEV_I2C_MasterReadData(LEP_UINT16  portID,               // User-defi
    return(result);
 }
 
-LEP_RESULT DEV_I2C_MasterWriteData(LEP_UINT16  portID,              // User-defined port ID
-                                   LEP_UINT8   deviceAddress,       // Lepton Camera I2C Device Address
-                                   LEP_UINT16  regAddress,          // Lepton Register Address
-                                   LEP_UINT16 *writeDataPtr,        // Write DATA buffer pointer
-                                   LEP_UINT16  wordsToWrite,        // Number of 16-bit words to Write
-                                   LEP_UINT16 *numWordsWritten,     // Number of 16-bit words actually written
-                                   LEP_UINT16 *status)              // Transaction Status
+static LEP_RESULT raspi_MasterWriteData(LEP_UINT16  portID,              // User-defined port ID
+                                        LEP_UINT8   deviceAddress,       // Lepton Camera I2C Device Address
+                                        LEP_UINT16  regAddress,          // Lepton Register Address
+                                        LEP_UINT16 *writeDataPtr,        // Write DATA buffer pointer
+                                        LEP_UINT16  wordsToWrite,        // Number of 16-bit words to Write
+                                        LEP_UINT16 *numWordsWritten,     // Number of 16-bit words actually written
+                                        LEP_UINT16 *status)              // Transaction Status
 {
     LEP_RESULT result = LEP_OK;
    
    int raspi_result;
    
-   LEP_INT16 bytesOfDataToWrite = (wordsToWrite << 1);
-   LEP_INT16 bytesToWrite = bytesOfDataToWrite + ADDRESS_SIZE_BYTES;
-   LEP_INT16 bytesActuallyWritten = 0;
-   LEP_UINT8* txdata = (LEP_UINT8*)malloc(sizeof(LEP_UINT8)*(int)bytesToWrite);
+   LEP_INT32 bytesOfDataToWrite = (wordsToWrite << 1);
+   LEP_INT32 bytesToWrite = bytesOfDataToWrite + ADDRESS_SIZE_BYTES;
+   LEP_INT32 bytesActuallyWritten = 0;
+   LEP_UINT8* txdata = txBuffer[portID ? 1 : 0];
    LEP_UINT16 *dataPtr;
-   LEP_UINT16 *txPtr;
+   LEP_UINT8 *txPtr;
+
+   *numWordsWritten = 0;
+   if(bytesOfDataToWrite > RASPI_I2C_MAX_DATA_BYTES)
+   {
+      return(LEP_ERROR_I2C_BUFFER_OVERFLOW);
+   }
 
-   *(LEP_UINT16*)txdata = REVERSE_ENDIENESS_UINT16(regAddress);
-   dataPtr = (LEP_UINT16*)&writeDataPtr[0];
-   txPtr = (LEP_UINT16*)&txdata[ADDRESS_SIZE_BYTES]; //Don't overwrite the address bytes
+   txdata[0] = (LEP_UINT8)(regAddress >> 8);
+   txdata[1] = (LEP_UINT8)(regAddress & 0xFF);
+   dataPtr = writeDataPtr;
+   txPtr = &txdata[ADDRESS_SIZE_BYTES]; //Don't overwrite the address bytes
    while(wordsToWrite--){
-      *txPtr++ = (LEP_UINT16)REVERSE_ENDIENESS_UINT16(*dataPtr);
+      *txPtr++ = (LEP_UINT8)(*dataPtr >> 8);
+      *txPtr++ = (LEP_UINT8)(*dataPtr & 0xFF);
       dataPtr++;
    }
 
-   //raspi_result = aa_i2c_write(handle, device_addr, AA_I2C_NO_FLAGS, bytesToWrite, (LEP_UINT8*)writeDataPtr);
-   
-    //DONE: here we do raspi_i2c_write_ext
-    //raspi_result = aa_i2c_write_ext(handle, deviceAddress, AA_I2C_NO_FLAGS, bytesToWrite, (LEP_UINT8*)txdata, (u16*)&bytesActuallyWritten);
-    
-    int leptonDevice;
-    if(portID) {
-	leptonDevice = leptonDevice1;
-    } else {
-	leptonDevice = leptonDevice0;
-    }
-
-    bytesActuallyWritten = write(leptonDevice, (LEP_UINT8*)txdata, bytesToWrite);
+    bytesActuallyWritten = write(raspi_device(portID), txdata, bytesToWrite);
 
     if(bytesActuallyWritten < 0) {
 	//if it's -1, we had error, no bytes written or something. just lie and say no bytes written
@@ -318,10 +357,9 @@ LEP_RESULT DEV_I2C_MasterWriteData(LEP_UINT16  portID,              // User-defi
 	raspi_result = LEP_OK;
     }
 
-   *numWordsWritten = (bytesActuallyWritten >> 1);
+   *numWordsWritten = (LEP_UINT16)(bytesActuallyWritten >> 1);
 
    result = (LEP_RESULT)raspi_result;
-   free(txdata);
 
    if(raspi_result != 0 || bytesActuallyWritten != bytesToWrite)
    {
@@ -330,6 +368,55 @@ LEP_RESULT DEV_I2C_MasterWriteData(LEP_UINT16  portID,              // User-defi
    return(result);
 }
 
+/**
+ * Selects the backend every DEV_I2C call goes to. Call before opening the
+ * port; NULL restores the hardware backend.
+ */
+void DEV_I2C_SetBackend(const DEV_I2C_BACKEND_T *backend)
+{
+   i2cBackend = backend ? backend : &raspiBackend;
+}
+
+const DEV_I2C_BACKEND_T *DEV_I2C_GetBackend(void)
+{
+   return(i2cBackend);
+}
+
+LEP_RESULT DEV_I2C_MasterInit(LEP_UINT16 portID, 
+                              LEP_UINT16 *BaudRate)
+{
+   return(i2cBackend->init(portID, BaudRate));
+}
+
+LEP_RESULT DEV_I2C_MasterClose()
+{
+   return(i2cBackend->close());
+}
+
+LEP_RESULT DEV_I2C_MasterReadData(LEP_UINT16  portID,
+                                  LEP_UINT8   deviceAddress,
+                                  LEP_UINT16  regAddress,
+                                  LEP_UINT16 *readDataPtr,
+                                  LEP_UINT16  wordsToRead,
+                                  LEP_UINT16 *numWordsRead,
+                                  LEP_UINT16 *status)
+{
+   return(i2cBackend->readData(portID, deviceAddress, regAddress,
+                               readDataPtr, wordsToRead, numWordsRead, status));
+}
+
+LEP_RESULT DEV_I2C_MasterWriteData(LEP_UINT16  portID,
+                                   LEP_UINT8   deviceAddress,
+                                   LEP_UINT16  regAddress,
+                                   LEP_UINT16 *writeDataPtr,
+                                   LEP_UINT16  wordsToWrite,
+                                   LEP_UINT16 *numWordsWritten,
+                                   LEP_UINT16 *status)
+{
+   return(i2cBackend->writeData(portID, deviceAddress, regAddress,
+                                writeDataPtr, wordsToWrite, numWordsWritten, status));
+}
+
 LEP_RESULT DEV_I2C_MasterReadRegister( LEP_UINT16 portID,
                                        LEP_UINT8  deviceAddress, 
                                        LEP_UINT16 regAddress,
@@ -378,4 +465,9 @@ LEP_RESULT DEV_I2C_MasterStatus(void )
 /** PRIVATE MODULE FUNCTIONS                                                 **/
 /******************************************************************************/
 
+static int raspi_device(LEP_UINT16 portID)
+{
+   return(portID ? leptonDevice1 : leptonDevice0);
+}
+
 
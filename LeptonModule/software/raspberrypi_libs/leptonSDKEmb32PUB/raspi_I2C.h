@@ -45,6 +45,36 @@ extern "C"
 /** EXPORTED TYPE DEFINITIONS                                                **/
 /******************************************************************************/
 
+    /* A device-specific I2C master. The default talks to /dev/i2c-N; see
+    ** sim_I2C.h for an in-process Lepton CCI simulator.
+    */
+    typedef struct DEV_I2C_BACKEND_TAG
+    {
+        const char *name;
+
+        LEP_RESULT (*init)(LEP_UINT16 portID,
+                           LEP_UINT16 *BaudRate);
+
+        LEP_RESULT (*close)(void);
+
+        LEP_RESULT (*readData)(LEP_UINT16 portID,
+                               LEP_UINT8   deviceAddress,
+                               LEP_UINT16  regAddress,
+                               LEP_UINT16 *readDataPtr,
+                               LEP_UINT16  wordsToRead,
+                               LEP_UINT16 *numWordsRead,
+                               LEP_UINT16 *status);
+
+        LEP_RESULT (*writeData)(LEP_UINT16 portID,
+                                LEP_UINT8   deviceAddress,
+                                LEP_UINT16  regAddress,
+                                LEP_UINT16 *writeDataPtr,
+                                LEP_UINT16  wordsToWrite,
+                                LEP_UINT16 *numWordsWritten,
+                                LEP_UINT16 *status);
+
+    }DEV_I2C_BACKEND_T, *DEV_I2C_BACKEND_T_PTR;
+
 /******************************************************************************/
 /** EXPORTED PUBLIC DATA                                                     **/
 /******************************************************************************/
@@ -53,6 +83,10 @@ extern "C"
 /** EXPORTED PUBLIC FUNCTIONS                                                **/
 /******************************************************************************/
 
+    extern void DEV_I2C_SetBackend(const DEV_I2C_BACKEND_T *backend);
+
+    extern const DEV_I2C_BACKEND_T *DEV_I2C_GetBackend(void);
+
     extern LEP_RESULT DEV_I2C_MasterInit(LEP_UINT16 portID,
                                          LEP_UINT16 *BaudRate);
 
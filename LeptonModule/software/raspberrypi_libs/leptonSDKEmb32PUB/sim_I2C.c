@@ -0,0 +1,450 @@
+/*******************************************************************************
+**
+**    File NAME: sim_I2C.c
+**
+**      DESCRIPTION: In-process Lepton CCI simulator. Models the register
+**                   interface the SDK drives (STATUS, COMMAND, DATA LENGTH,
+**                   DATA 0-15, CRC and the block data buffer) with BUSY
+**                   timing, attribute storage and fault injection.
+**
+*******************************************************************************/
+/******************************************************************************/
+/** INCLUDE FILES                                                            **/
+/******************************************************************************/
+
+#include "LEPTON_Types.h"
+#include "LEPTON_ErrorCodes.h"
+#include "LEPTON_I2C_Reg.h"
+#include "LEPTON_SYS.h"
+#include "LEPTON_OEM.h"
+#include "crc16.h"
+#include "sim_I2C.h"
+
+#include <string.h>
+#include <time.h>
+
+/******************************************************************************/
+/** LOCAL DEFINES                                                            **/
+/******************************************************************************/
+
+/* Register words from POWER (0x0000) through DATA CRC (0x0028)
+*/
+#define SIM_NUM_REGS                ((LEP_I2C_DATA_CRC_REG >> 1) + 1)
+
+/* Block data buffer, both halves, in words
+*/
+#define SIM_BUFFER_WORDS            1024
+
+#define SIM_MAX_ATTRIBUTES          32
+
+/* Booted, in normal (not virgin) boot mode
+*/
+#define SIM_STATUS_IDLE             0x0006
+
+#define SIM_COMMAND_BASE(id)        ((id) & ~0x0003)
+
+/******************************************************************************/
+/** LOCAL TYPE DEFINITIONS                                                   **/
+/******************************************************************************/
+
+typedef struct SIM_ATTRIBUTE_TAG
+{
+    LEP_UINT16 id;                  /* command ID without type bits */
+    LEP_UINT16 length;              /* words */
+    LEP_UINT16 data[SIM_BUFFER_WORDS];
+
+}SIM_ATTRIBUTE_T;
+
+/******************************************************************************/
+/** PRIVATE DATA DECLARATIONS                                                **/
+/******************************************************************************/
+
+static SIM_I2C_CONFIG_T simConfig =
+{
+    400,                            /* busKHz */
+    300,                            /* getBusyUs */
+    500,                            /* setBusyUs */
+    1000,                           /* runBusyUs */
+    200000,                         /* ffcBusyUs */
+    1000000,                        /* rebootBusyUs */
+    0,                              /* nackEvery */
+    0,                              /* errorEvery */
+    LEP_ERROR,                      /* errorCode */
+    1                               /* crcEnabled */
+};
+
+static SIM_I2C_STATS_T simStats;
+
+static LEP_UINT16 simRegs[SIM_NUM_REGS];
+static LEP_UINT16 simBuffer[SIM_BUFFER_WORDS];
+static LEP_UINT16 simStatusCode;            /* high byte of STATUS after completion */
+static LEP_UINT64 simBusyUntilUs;
+
+static SIM_ATTRIBUTE_T simAttributes[SIM_MAX_ATTRIBUTES];
+static LEP_UINT32 simNumAttributes;
+
+static LEP_UINT32 simTransfers;
+static LEP_UINT32 simCommands;
+
+/******************************************************************************/
+/** PRIVATE FUNCTION DECLARATIONS                                            **/
+/******************************************************************************/
+
+static LEP_RESULT sim_MasterInit(LEP_UINT16 portID,
+                                 LEP_UINT16 *BaudRate);
+static LEP_RESULT sim_MasterClose(void);
+static LEP_RESULT sim_MasterReadData(LEP_UINT16 portID,
+                                     LEP_UINT8 deviceAddress,
+                                     LEP_UINT16 regAddress,
+                                     LEP_UINT16 *readDataPtr,
+                                     LEP_UINT16 wordsToRead,
+                                     LEP_UINT16 *numWordsRead,
+                                     LEP_UINT16 *status);
+static LEP_RESULT sim_MasterWriteData(LEP_UINT16 portID,
+                                      LEP_UINT8 deviceAddress,
+                                      LEP_UINT16 regAddress,
+                                      LEP_UINT16 *writeDataPtr,
+                                      LEP_UINT16 wordsToWrite,
+                                      LEP_UINT16 *numWordsWritten,
+                                      LEP_UINT16 *status);
+
+static LEP_UINT64 sim_NowUs(void);
+static void sim_BusDelay(LEP_UINT32 bytes);
+static LEP_BOOL sim_Nack(void);
+static LEP_UINT16 *sim_Word(LEP_UINT16 regAddress, LEP_UINT16 words);
+static void sim_RunCommand(LEP_UINT16 commandID);
+static SIM_ATTRIBUTE_T *sim_FindAttribute(LEP_UINT16 id, LEP_BOOL create);
+
+static const DEV_I2C_BACKEND_T simBackend =
+{
+   "sim",
+   sim_MasterInit,
+   sim_MasterClose,
+   sim_MasterReadData,
+   sim_MasterWriteData
+};
+
+/******************************************************************************/
+/** EXPORTED PUBLIC DATA                                                     **/
+/******************************************************************************/
+
+/******************************************************************************/
+/** EXPORTED PUBLIC FUNCTIONS                                                **/
+/******************************************************************************/
+
+const DEV_I2C_BACKEND_T *SIM_I2C_GetBackend(void)
+{
+   return(&simBackend);
+}
+
+void SIM_I2C_GetConfig(SIM_I2C_CONFIG_T_PTR configPtr)
+{
+   if(configPtr != NULL)
+   {
+      *configPtr = simConfig;
+   }
+}
+
+void SIM_I2C_SetConfig(const SIM_I2C_CONFIG_T *configPtr)
+{
+   if(configPtr != NULL)
+   {
+      simConfig = *configPtr;
+   }
+}
+
+void SIM_I2C_GetStats(SIM_I2C_STATS_T_PTR statsPtr)
+{
+   if(statsPtr != NULL)
+   {
+      *statsPtr = simStats;
+   }
+}
+
+void SIM_I2C_Reset(void)
+{
+   memset(&simStats, 0, sizeof(simStats));
+   memset(simRegs, 0, sizeof(simRegs));
+   memset(simBuffer, 0, sizeof(simBuffer));
+   simStatusCode = 0;
+   simBusyUntilUs = 0;
+   simNumAttributes = 0;
+   simTransfers = 0;
+   simCommands = 0;
+}
+
+/******************************************************************************/
+/** PRIVATE MODULE FUNCTIONS                                                 **/
+/******************************************************************************/
+
+static LEP_RESULT sim_MasterInit(LEP_UINT16 portID,
+                                 LEP_UINT16 *BaudRate)
+{
+   if(BaudRate != NULL && simConfig.busKHz != 0)
+   {
+      *BaudRate = (LEP_UINT16)simConfig.busKHz;
+   }
+   return(LEP_OK);
+}
+
+static LEP_RESULT sim_MasterClose(void)
+{
+   return(LEP_OK);
+}
+
+static LEP_RESULT sim_MasterReadData(LEP_UINT16 portID,
+                                     LEP_UINT8 deviceAddress,
+                                     LEP_UINT16 regAddress,
+                                     LEP_UINT16 *readDataPtr,
+                                     LEP_UINT16 wordsToRead,
+                                     LEP_UINT16 *numWordsRead,
+                                     LEP_UINT16 *status)
+{
+   LEP_UINT16 *src;
+   LEP_UINT16 i;
+
+   /* address + register write, repeated start + address, data
+   */
+   sim_BusDelay(4 + 2 * (LEP_UINT32)wordsToRead);
+   simStats.reads++;
+   *numWordsRead = 0;
+
+   if(sim_Nack())
+   {
+      return(LEP_ERROR_I2C_FAIL);
+   }
+
+   if(regAddress == LEP_I2C_STATUS_REG && wordsToRead == 1)
+   {
+      simStats.statusReads++;
+      if(sim_NowUs() < simBusyUntilUs)
+      {
+         simStats.busyReads++;
+         readDataPtr[0] = SIM_STATUS_IDLE | LEP_I2C_STATUS_BUSY_BIT_MASK;
+      }
+      else
+      {
+         readDataPtr[0] = SIM_STATUS_IDLE | simStatusCode;
+      }
+      *numWordsRead = 1;
+      return(LEP_OK);
+   }
+
+   src = sim_Word(regAddress, wordsToRead);
+   if(src == NULL)
+   {
+      return(LEP_ERROR_I2C_FAIL);
+   }
+   for(i = 0; i < wordsToRead; i++)
+   {
+      readDataPtr[i] = src[i];
+   }
+   *numWordsRead = wordsToRead;
+
+   return(LEP_OK);
+}
+
+static LEP_RESULT sim_MasterWriteData(LEP_UINT16 portID,
+                                      LEP_UINT8 deviceAddress,
+                                      LEP_UINT16 regAddress,
+                                      LEP_UINT16 *writeDataPtr,
+                                      LEP_UINT16 wordsToWrite,
+                                      LEP_UINT16 *numWordsWritten,
+                                      LEP_UINT16 *status)
+{
+   LEP_UINT16 *dst;
+   LEP_UINT16 i;
+
+   sim_BusDelay(3 + 2 * (LEP_UINT32)wordsToWrite);
+   simStats.writes++;
+   *numWordsWritten = 0;
+
+   if(sim_Nack())
+   {
+      return(LEP_ERROR);
+   }
+
+   if(regAddress == LEP_I2C_COMMAND_REG && wordsToWrite == 1)
+   {
+      /* The camera ignores commands while BUSY
+      */
+      if(sim_NowUs() < simBusyUntilUs)
+      {
+         simStats.commandsWhileBusy++;
+      }
+      else
+      {
+         sim_RunCommand(writeDataPtr[0]);
+      }
+      *numWordsWritten = 1;
+      return(LEP_OK);
+   }
+
+   /* STATUS and CRC are read-only
+   */
+   if(regAddress == LEP_I2C_STATUS_REG || regAddress == LEP_I2C_DATA_CRC_REG)
+   {
+      return(LEP_ERROR);
+   }
+
+   dst = sim_Word(regAddress, wordsToWrite);
+   if(dst == NULL)
+   {
+      return(LEP_ERROR);
+   }
+   for(i = 0; i < wordsToWrite; i++)
+   {
+      dst[i] = writeDataPtr[i];
+   }
+   *numWordsWritten = wordsToWrite;
+
+   return(LEP_OK);
+}
+
+static LEP_UINT64 sim_NowUs(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return((LEP_UINT64)ts.tv_sec * 1000000u + (LEP_UINT64)(ts.tv_nsec / 1000));
+}
+
+/* Time the bytes take on the wire: 9 clocks each plus start and stop
+*/
+static void sim_BusDelay(LEP_UINT32 bytes)
+{
+   LEP_UINT32 us;
+   struct timespec pause;
+
+   if(simConfig.busKHz == 0)
+   {
+      return;
+   }
+   us = (bytes * 9 + 2) * 1000u / simConfig.busKHz;
+   pause.tv_sec = us / 1000000u;
+   pause.tv_nsec = (long)(us % 1000000u) * 1000;
+   nanosleep(&pause, NULL);
+}
+
+static LEP_BOOL sim_Nack(void)
+{
+   simTransfers++;
+   if(simConfig.nackEvery != 0 && simTransfers % simConfig.nackEvery == 0)
+   {
+      simStats.nacks++;
+      return(LEP_TRUE);
+   }
+   return(LEP_FALSE);
+}
+
+/* Maps a register address to its backing words, or NULL when the access
+** runs outside the register file or the block data buffer.
+*/
+static LEP_UINT16 *sim_Word(LEP_UINT16 regAddress, LEP_UINT16 words)
+{
+   LEP_UINT32 index;
+
+   if(regAddress & 1)
+   {
+      return(NULL);
+   }
+   if(regAddress >= LEP_DATA_BUFFER_0_BASE_ADDR)
+   {
+      index = (LEP_UINT32)(regAddress - LEP_DATA_BUFFER_0_BASE_ADDR) >> 1;
+      return((index + words <= SIM_BUFFER_WORDS) ? &simBuffer[index] : NULL);
+   }
+   index = (LEP_UINT32)regAddress >> 1;
+   return((index + words <= SIM_NUM_REGS) ? &simRegs[index] : NULL);
+}
+
+static SIM_ATTRIBUTE_T *sim_FindAttribute(LEP_UINT16 id, LEP_BOOL create)
+{
+   LEP_UINT32 i;
+
+   for(i = 0; i < simNumAttributes; i++)
+   {
+      if(simAttributes[i].id == id)
+      {
+         return(&simAttributes[i]);
+      }
+   }
+   if(!create || simNumAttributes == SIM_MAX_ATTRIBUTES)
+   {
+      return(NULL);
+   }
+   simAttributes[simNumAttributes].id = id;
+   simAttributes[simNumAttributes].length = 0;
+   return(&simAttributes[simNumAttributes++]);
+}
+
+/* Executes a command on write of the COMMAND register. Data moves between
+** DATA 0-15 (16 words or less) or the block buffer and the attribute store,
+** and STATUS reads BUSY for the configured time.
+*/
+static void sim_RunCommand(LEP_UINT16 commandID)
+{
+   LEP_UINT16 type = commandID & 0x0003;
+   LEP_UINT16 id = SIM_COMMAND_BASE(commandID);
+   LEP_UINT16 length = simRegs[LEP_I2C_DATA_LENGTH_REG >> 1];
+   LEP_UINT16 *data = (length <= 16) ? &simRegs[LEP_I2C_DATA_0_REG >> 1] : simBuffer;
+   LEP_UINT32 busyUs;
+   SIM_ATTRIBUTE_T *attr;
+
+   if(length > SIM_BUFFER_WORDS)
+   {
+      length = SIM_BUFFER_WORDS;
+   }
+   simCommands++;
+   simStatusCode = 0;
+
+   if(type == LEP_GET_TYPE)
+   {
+      simStats.commands[0]++;
+      busyUs = simConfig.getBusyUs;
+      attr = sim_FindAttribute(id, LEP_FALSE);
+      memset(data, 0, length * sizeof(LEP_UINT16));
+      if(attr != NULL)
+      {
+         memcpy(data, attr->data, (attr->length < length ? attr->length : length) * sizeof(LEP_UINT16));
+      }
+   }
+   else if(type == LEP_SET_TYPE)
+   {
+      simStats.commands[1]++;
+      busyUs = simConfig.setBusyUs;
+      attr = sim_FindAttribute(id, LEP_TRUE);
+      if(attr != NULL)
+      {
+         memcpy(attr->data, data, length * sizeof(LEP_UINT16));
+         attr->length = length;
+      }
+   }
+   else
+   {
+      simStats.commands[2]++;
+      busyUs = simConfig.runBusyUs;
+      if(id == SIM_COMMAND_BASE(FLR_CID_SYS_RUN_FFC) ||
+         id == SIM_COMMAND_BASE(LEP_CID_OEM_FFC_NORMALIZATION_TARGET))
+      {
+         busyUs = simConfig.ffcBusyUs;
+      }
+      else if(id == SIM_COMMAND_BASE(LEP_CID_OEM_REBOOT))
+      {
+         busyUs = simConfig.rebootBusyUs;
+      }
+   }
+
+   simRegs[LEP_I2C_DATA_CRC_REG >> 1] = 0;
+   if(simConfig.crcEnabled && length > 0)
+   {
+      simRegs[LEP_I2C_DATA_CRC_REG >> 1] = (LEP_UINT16)CalcCRC16Words(length, (short*)data);
+   }
+
+   if(simConfig.errorEvery != 0 && simCommands % simConfig.errorEvery == 0)
+   {
+      simStats.errors++;
+      simStatusCode = (LEP_UINT16)(((LEP_UINT16)simConfig.errorCode & 0xFF) << 8);
+   }
+
+   simBusyUntilUs = sim_NowUs() + busyUs;
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************
+**
+**    File NAME: sim_I2C.h
+**
+**      DESCRIPTION: In-process Lepton CCI simulator, usable as the
+**                   DEV_I2C backend so the SDK control path runs without
+**                   a camera attached.
+**
+*******************************************************************************/
+#ifndef _SIM_I2C_H_
+    #define _SIM_I2C_H_
+
+    #ifdef __cplusplus
+extern "C"
+{
+    #endif
+/******************************************************************************/
+/** INCLUDE FILES                                                            **/
+/******************************************************************************/
+    #include "LEPTON_Types.h"
+    #include "LEPTON_ErrorCodes.h"
+    #include "raspi_I2C.h"
+
+/******************************************************************************/
+/** EXPORTED DEFINES                                                         **/
+/******************************************************************************/
+
+/******************************************************************************/
+/** EXPORTED TYPE DEFINITIONS                                                **/
+/******************************************************************************/
+
+    /* Timing and fault injection. Times are in microseconds; 0 disables.
+    */
+    typedef struct SIM_I2C_CONFIG_TAG
+    {
+        LEP_UINT32 busKHz;              /* bus clock for transfer time, 0 = instant */
+        LEP_UINT32 getBusyUs;           /* BUSY time after a GET command */
+        LEP_UINT32 setBusyUs;           /* BUSY time after a SET command */
+        LEP_UINT32 runBusyUs;           /* BUSY time after a RUN command */
+        LEP_UINT32 ffcBusyUs;           /* BUSY time after an FFC RUN */
+        LEP_UINT32 rebootBusyUs;        /* BUSY time after a reboot RUN */
+        LEP_UINT32 nackEvery;           /* every Nth transfer fails on the bus */
+        LEP_UINT32 errorEvery;          /* every Nth command completes with errorCode */
+        LEP_RESULT errorCode;
+        LEP_UINT32 crcEnabled;          /* 0 leaves the CRC register at 0, like older firmware */
+
+    }SIM_I2C_CONFIG_T, *SIM_I2C_CONFIG_T_PTR;
+
+    typedef struct SIM_I2C_STATS_TAG
+    {
+        LEP_UINT32 reads;               /* read transfers */
+        LEP_UINT32 writes;              /* write transfers */
+        LEP_UINT32 statusReads;         /* reads of the STATUS register */
+        LEP_UINT32 busyReads;           /* ... that returned BUSY */
+        LEP_UINT32 commands[3];         /* GET, SET, RUN */
+        LEP_UINT32 commandsWhileBusy;   /* COMMAND written while BUSY (ignored) */
+        LEP_UINT32 nacks;               /* injected bus failures */
+        LEP_UINT32 errors;              /* injected command errors */
+
+    }SIM_I2C_STATS_T, *SIM_I2C_STATS_T_PTR;
+
+/******************************************************************************/
+/** EXPORTED PUBLIC DATA                                                     **/
+/******************************************************************************/
+
+/******************************************************************************/
+/** EXPORTED PUBLIC FUNCTIONS                                                **/
+/******************************************************************************/
+
+    /* Pass to DEV_I2C_SetBackend() before opening the port
+    */
+    extern const DEV_I2C_BACKEND_T *SIM_I2C_GetBackend(void);
+
+    extern void SIM_I2C_GetConfig(SIM_I2C_CONFIG_T_PTR configPtr);
+
+    extern void SIM_I2C_SetConfig(const SIM_I2C_CONFIG_T *configPtr);
+
+    extern void SIM_I2C_GetStats(SIM_I2C_STATS_T_PTR statsPtr);
+
+    /* Clears registers, stored attributes and statistics; keeps the config
+    */
+    extern void SIM_I2C_Reset(void);
+
+/******************************************************************************/
+    #ifdef __cplusplus
+}
+    #endif
+
+#endif  /* _SIM_I2C_H_ */
@@ -0,0 +1,91 @@
+#include "AutoRange.h"
+
+#include <algorithm>
+#include <cmath>
+
+void AutoRange::setClipPercent(double pct)
+{
+    m_clip = std::max(0.0, std::min(10.0, pct));
+}
+
+void AutoRange::setSmoothing(double alpha)
+{
+    m_alpha = std::max(0.01, std::min(1.0, alpha));
+}
+
+void AutoRange::setHysteresis(double share)
+{
+    m_hyst = std::max(0.0, std::min(0.5, share));
+}
+
+void AutoRange::begin()
+{
+    std::fill(m_hist.begin(), m_hist.end(), 0);
+    m_under = m_over = m_n = 0;
+    m_fmin = 0xffff;
+    m_fmax = 0;
+}
+
+// Lower edge of the bin holding the pixel of the given rank from the bottom.
+uint16_t AutoRange::percentileLow(uint32_t rank) const
+{
+    if (rank < m_under) return m_fmin;
+    uint32_t cum = m_under;
+    for (int b = 0; b < Bins; ++b) {
+        cum += m_hist[b];
+        if (cum > rank) return std::max<int>(m_fmin, m_binLo + (b << m_binShift));
+    }
+    return m_fmax;
+}
+
+// Upper edge of the bin holding the pixel of the given rank from the top.
+uint16_t AutoRange::percentileHigh(uint32_t rank) const
+{
+    if (rank < m_over) return m_fmax;
+    uint32_t cum = m_over;
+    for (int b = Bins - 1; b >= 0; --b) {
+        cum += m_hist[b];
+        if (cum > rank) return std::min<int>(m_fmax, m_binLo + ((b + 1) << m_binShift) - 1);
+    }
+    return m_fmin;
+}
+
+void AutoRange::end()
+{
+    if (m_n == 0) return;
+
+    // the first frame has no histogram window yet, it sets the range as is
+    uint16_t tlo = m_fmin, thi = m_fmax;
+    if (m_valid) {
+        uint32_t rank = (uint32_t)(m_n * m_clip / 100.0);
+        tlo = percentileLow(rank);
+        thi = percentileHigh(rank);
+        if (thi <= tlo) {
+            tlo = m_fmin;
+            thi = m_fmax;
+        }
+    }
+
+    if (!m_valid) {
+        m_lo = m_outLo = tlo;
+        m_hi = m_outHi = thi;
+        m_valid = true;
+    } else {
+        m_lo += m_alpha * (tlo - m_lo);
+        m_hi += m_alpha * (thi - m_hi);
+        double band = m_hyst * std::max(1.0, m_hi - m_lo);
+        if (std::fabs(m_lo - m_outLo) > band || std::fabs(m_hi - m_outHi) > band) {
+            m_outLo = (uint16_t)std::lround(m_lo);
+            m_outHi = (uint16_t)std::lround(m_hi);
+        }
+    }
+
+    // next frame's window: this frame's span plus a quarter on each side
+    int margin = (m_fmax - m_fmin) / 4 + 16;
+    int lo = std::max(0, m_fmin - margin);
+    int hi = std::min(0xffff, m_fmax + margin);
+    int shift = 0;
+    while (((hi - lo) >> shift) >= Bins) shift++;
+    m_binLo = (uint16_t)lo;
+    m_binShift = shift;
+}
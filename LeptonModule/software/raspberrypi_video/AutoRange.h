@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Display range for the linear stretch, built from statistics the decoder
+// collects while it unpacks a frame (add() per pixel), so there is no
+// separate scan pass. The range used for a frame comes from the frames
+// before it:
+//
+//   - the low/high percentiles of a histogram over a window around the
+//     last range drop a few outlier pixels (dead pixels, a glint),
+//   - an exponential moving average smooths the percentiles over frames,
+//   - the published range only moves once the average has drifted more
+//     than a share of the span, so a steady scene keeps a steady palette.
+class AutoRange {
+public:
+    AutoRange() : m_hist(Bins) {}
+
+    // percent of pixels ignored at each end, 0 = exact min/max
+    void setClipPercent(double pct);
+    // weight of the newest frame, 1 = no smoothing
+    void setSmoothing(double alpha);
+    // share of the span the average must move before the range follows
+    void setHysteresis(double share);
+
+    // true once a frame has been seen
+    bool valid() const { return m_valid; }
+    uint16_t lo() const { return m_outLo; }
+    uint16_t hi() const { return m_outHi; }
+
+    void reset() { m_valid = false; }
+
+    void begin();
+    inline void add(uint16_t v)
+    {
+        if (v < m_fmin) m_fmin = v;
+        if (v > m_fmax) m_fmax = v;
+        // below the window the difference wraps to far more than Bins
+        unsigned b = (unsigned)(v - m_binLo) >> m_binShift;
+        if (b < (unsigned)Bins) m_hist[b]++;
+        else if (v < m_binLo) m_under++;
+        else m_over++;
+        m_n++;
+    }
+    // folds the frame into the range; frames without pixels are ignored
+    void end();
+
+    enum { Bins = 1024 };
+
+private:
+    uint16_t percentileLow(uint32_t rank) const;
+    uint16_t percentileHigh(uint32_t rank) const;
+
+    double m_clip = 0.05;
+    double m_alpha = 0.25;
+    double m_hyst = 0.02;
+
+    // current frame
+    std::vector<uint32_t> m_hist;
+    uint32_t m_under = 0, m_over = 0, m_n = 0;
+    uint16_t m_fmin = 0, m_fmax = 0;
+    // histogram window, [m_binLo, m_binLo + (Bins << m_binShift))
+    uint16_t m_binLo = 0;
+    int m_binShift = 16;
+
+    bool m_valid = false;
+    double m_lo = 0, m_hi = 0;  // smoothed
+    uint16_t m_outLo = 0, m_outHi = 0;
+};
@@ -0,0 +1,491 @@
+#include "Bench.h"
+#include "EdgeFilter.h"
+#include "HttpParser.h"
+#include "ToneMapper.h"
+#include "AutoRange.h"
+
+#include "leptonSDKEmb32PUB/LEPTON_SDK.h"
+#include "leptonSDKEmb32PUB/LEPTON_AGC.h"
+#include "leptonSDKEmb32PUB/LEPTON_SYS.h"
+#include "leptonSDKEmb32PUB/LEPTON_VID.h"
+#include "leptonSDKEmb32PUB/LEPTON_I2C_Protocol.h"
+#include "leptonSDKEmb32PUB/sim_I2C.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <ctime>
+
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+static double cpuMs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Camera edge overlay: CPU per 640x480 YUYV frame at each working size.
+static int benchEdges()
+{
+    const int srcW = 640, srcH = 480, frames = 200;
+    const int sizes[][2] = { {640, 480}, {320, 240}, {160, 120}, {80, 60} };
+
+    // checkerboard plus noise, so both edge and flat areas are exercised
+    std::vector<uint8_t> yuyv(srcW * srcH * 2);
+    srand(1);
+    for (int y = 0; y < srcH; ++y) {
+        for (int x = 0; x < srcW; ++x) {
+            uint8_t* p = &yuyv[(y * srcW + x) * 2];
+            p[0] = (uint8_t)(((x / 24 + y / 18) & 1) * 150 + rand() % 40);
+            p[1] = 128;
+        }
+    }
+
+    std::vector<uint8_t> out(srcW * srcH);
+    EdgeFilter edge;
+
+    printf("edges: %dx%d YUYV source, %d frames per run\n", srcW, srcH, frames);
+    printf("%-10s %12s %12s\n", "work size", "sobel ms", "thin ms");
+    for (const auto& sz : sizes) {
+        double ms[2];
+        for (int thin = 0; thin < 2; ++thin) {
+            edge.setThin(thin != 0);
+            double t0 = cpuMs();
+            for (int i = 0; i < frames; ++i)
+                edge.processYuyv(yuyv.data(), srcW, srcH, srcW * 2,
+                                 out.data(), sz[0], sz[0], sz[1]);
+            ms[thin] = (cpuMs() - t0) / frames;
+        }
+        char label[16];
+        snprintf(label, sizeof(label), "%dx%d", sz[0], sz[1]);
+        printf("%-10s %12.3f %12.3f\n", label, ms[0], ms[1]);
+    }
+    return 0;
+}
+
+// Thermal tone mapping: CPU per frame and palette entries used, on a warm
+// gradient with a small hot spot (the case that starves a min/max stretch).
+static int benchTone()
+{
+    const int sizes[][2] = { {160, 120}, {80, 60} };
+    const int frames = 500;
+    const char* const names[] = { "linear", "heq", "plateau", "clahe" };
+
+    printf("tone: %d frames per run, 27 Hz budget %.1f ms\n", frames, 1000.0 / 27);
+    printf("%-8s %-8s %10s %8s\n", "size", "mode", "ms/frame", "levels");
+    for (const auto& sz : sizes) {
+        const int w = sz[0], h = sz[1], n = w * h;
+        std::vector<uint16_t> px(n);
+        srand(1);
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x) {
+                int dx = x - w * 3 / 4, dy = y - h / 4;
+                bool hot = dx * dx + dy * dy < n / 400;
+                px[y * w + x] = (uint16_t)(hot ? 11800 + rand() % 40 : 7900 + (x + y) * 800 / (w + h) + rand() % 30);
+            }
+        std::vector<uint8_t> out(n);
+
+        for (int m = 0; m < 4; ++m) {
+            ToneMapper tone;
+            if (m > 0) tone.setMode((ToneMapper::Mode)(m - 1));
+            double t0 = cpuMs();
+            for (int f = 0; f < frames; ++f) {
+                if (m > 0) {
+                    // add() runs in LeptonThread's unpack loop
+                    tone.begin();
+                    for (int i = 0; i < n; ++i) tone.add(px[i]);
+                    tone.map(px.data(), w, h, out.data());
+                    continue;
+                }
+                // what LeptonThread does in linear mode
+                uint16_t lo = 65535, hi = 0;
+                for (int i = 0; i < n; ++i) {
+                    lo = std::min(lo, px[i]);
+                    hi = std::max(hi, px[i]);
+                }
+                float scale = 255.0f / (hi - lo);
+                for (int i = 0; i < n; ++i) out[i] = (uint8_t)std::min(255.0f, (px[i] - lo) * scale);
+            }
+            double ms = (cpuMs() - t0) / frames;
+
+            bool used[256] = {};
+            int levels = 0;
+            for (int i = 0; i < n; ++i) {
+                if (!used[out[i]]) levels++;
+                used[out[i]] = true;
+            }
+            char label[16];
+            snprintf(label, sizeof(label), "%dx%d", w, h);
+            printf("%-8s %-8s %10.3f %8d\n", label, names[m], ms, levels);
+        }
+    }
+    return 0;
+}
+
+// Linear auto range: per-frame min/max against AutoRange on a noisy scene
+// with one pixel flickering hot, then a real scene change halfway through.
+// Counts frames whose palette range changed, and the cost of getting it.
+static int benchRange()
+{
+    const int w = 160, h = 120, n = w * h, frames = 400;
+    std::vector<uint16_t> px(n);
+    srand(1);
+
+    struct Run { const char* name; int changes; double meanStep; double ms; int lo, hi; };
+    Run runs[2] = { { "min/max", 0, 0, 0, 0, 0 }, { "autorange", 0, 0, 0, 0, 0 } };
+
+    for (int r = 0; r < 2; ++r) {
+        AutoRange ar;
+        int lastLo = -1, lastHi = -1;
+        double steps = 0, cpu = 0;
+        srand(1);
+        for (int f = 0; f < frames; ++f) {
+            int base = f < frames / 2 ? 7900 : 8300;
+            for (int i = 0; i < n; ++i) px[i] = (uint16_t)(base + (i % w) * 2 + rand() % 24);
+            if (f & 1) px[n / 3] = 12000; // a flickering hot pixel
+
+            int lo, hi;
+            double t0 = cpuMs();
+            if (r == 0) {
+                uint16_t a = 65535, b = 0;
+                for (int i = 0; i < n; ++i) {
+                    a = std::min(a, px[i]);
+                    b = std::max(b, px[i]);
+                }
+                lo = a;
+                hi = b;
+            } else {
+                ar.begin();
+                for (int i = 0; i < n; ++i) ar.add(px[i]);
+                ar.end();
+                lo = ar.lo();
+                hi = ar.hi();
+            }
+            cpu += cpuMs() - t0;
+
+            if (lastLo >= 0 && (lo != lastLo || hi != lastHi)) {
+                runs[r].changes++;
+                steps += std::abs(lo - lastLo) + std::abs(hi - lastHi);
+            }
+            lastLo = lo;
+            lastHi = hi;
+        }
+        runs[r].meanStep = runs[r].changes ? steps / runs[r].changes : 0;
+        runs[r].ms = cpu / frames;
+        runs[r].lo = lastLo;
+        runs[r].hi = lastHi;
+    }
+
+    printf("range: %dx%d, %d frames, hot pixel every other frame, scene +400 at frame %d\n",
+           w, h, frames, frames / 2);
+    printf("%-10s %8s %10s %10s %14s\n", "method", "changes", "mean step", "ms/frame", "final range");
+    for (const Run& r : runs)
+        printf("%-10s %8d %10.1f %10.4f %7d..%d\n", r.name, r.changes, r.meanStep, r.ms, r.lo, r.hi);
+    return 0;
+}
+
+static double wallMs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// HTTP request parser: browser-sized GETs, pipelined, fed in TCP-sized chunks.
+static int benchHttpParse()
+{
+    const int requests = 20000, chunk = 1460;
+    const QByteArray one =
+        "GET /api/cmd?line=set%20thermal%20opacity%200.5 HTTP/1.1\r\n"
+        "Host: 192.168.1.20:8080\r\n"
+        "Connection: keep-alive\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux armv7l) AppleWebKit/537.36 Chrome/120.0 Safari/537.36\r\n"
+        "Accept: application/json, text/javascript, */*; q=0.01\r\n"
+        "X-Requested-With: XMLHttpRequest\r\n"
+        "Referer: http://192.168.1.20:8080/\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "\r\n";
+
+    QByteArray stream;
+    stream.reserve(one.size() * requests);
+    for (int i = 0; i < requests; ++i) stream += one;
+
+    HttpParser parser;
+    HttpRequest req;
+    int parsed = 0;
+    double t0 = cpuMs();
+    for (int off = 0; off < stream.size(); off += chunk) {
+        parser.feed(stream.mid(off, chunk));
+        while (parser.next(&req) == HttpParser::Ready) parsed++;
+    }
+    double ms = cpuMs() - t0;
+
+    printf("httpparse: %d requests of %d bytes, %d byte reads\n", parsed, one.size(), chunk);
+    printf("%.0f requests/s, %.2f us per request\n", parsed / (ms / 1000.0), ms * 1000.0 / parsed);
+    return parsed == requests ? 0 : 1;
+}
+
+static int connectTo(const char* host, const char* port)
+{
+    addrinfo hints {}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0 || !res) return -1;
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+// Reads one response (headers + Content-Length body) from fd. buf keeps any
+// bytes of the next pipelined response. Returns false on EOF or error.
+static bool readResponse(int fd, std::string& buf)
+{
+    for (;;) {
+        size_t end = buf.find("\r\n\r\n");
+        if (end != std::string::npos) {
+            size_t len = 0;
+            size_t cl = buf.find("Content-Length:");
+            if (cl != std::string::npos && cl < end) len = strtoul(buf.c_str() + cl + 15, nullptr, 10);
+            if (buf.size() >= end + 4 + len) {
+                buf.erase(0, end + 4 + len);
+                return true;
+            }
+        }
+        char tmp[16384];
+        ssize_t n = read(fd, tmp, sizeof(tmp));
+        if (n <= 0) return false;
+        buf.append(tmp, n);
+    }
+}
+
+// Request rate against a running instance (the app itself, started normally):
+// one connection per request, keep-alive, and keep-alive with 8 pipelined.
+static int benchHttpLoad(const char* target)
+{
+    std::string hostPort = target ? target : "127.0.0.1:8080";
+    size_t colon = hostPort.rfind(':');
+    std::string host = colon == std::string::npos ? hostPort : hostPort.substr(0, colon);
+    std::string port = colon == std::string::npos ? "8080" : hostPort.substr(colon + 1);
+
+    const double runMs = 2000;
+    const std::string get = "GET /api/config HTTP/1.1\r\nHost: " + host + "\r\n\r\n";
+    const std::string getClose = "GET /api/config HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+
+    printf("http: GET /api/config on %s:%s, %.0f ms per mode\n", host.c_str(), port.c_str(), runMs);
+    printf("%-14s %10s %10s %10s\n", "mode", "req/s", "p50 ms", "p99 ms");
+
+    const char* modes[] = { "close", "keep-alive", "pipeline x8" };
+    for (int mode = 0; mode < 3; ++mode) {
+        const int depth = (mode == 2) ? 8 : 1;
+        std::vector<double> lat;
+        std::string buf;
+        int fd = -1;
+        long done = 0;
+        double t0 = wallMs();
+        while (wallMs() - t0 < runMs) {
+            double r0 = wallMs();
+            if (fd < 0 && (fd = connectTo(host.c_str(), port.c_str())) < 0) {
+                fprintf(stderr, "cannot connect to %s:%s\n", host.c_str(), port.c_str());
+                return 1;
+            }
+            std::string out;
+            for (int i = 0; i < depth; ++i) out += (mode == 0) ? getClose : get;
+            if (write(fd, out.data(), out.size()) != (ssize_t)out.size()) break;
+            bool ok = true;
+            for (int i = 0; i < depth && ok; ++i) ok = readResponse(fd, buf);
+            if (!ok) { fprintf(stderr, "%s: connection dropped\n", modes[mode]); break; }
+            if (mode == 0) { close(fd); fd = -1; buf.clear(); }
+            lat.push_back((wallMs() - r0) / depth);
+            done += depth;
+        }
+        double elapsed = wallMs() - t0;
+        if (fd >= 0) close(fd);
+        if (lat.empty()) continue;
+
+        std::sort(lat.begin(), lat.end());
+        printf("%-14s %10.0f %10.3f %10.3f\n", modes[mode], done / (elapsed / 1000.0),
+               lat[lat.size() / 2], lat[std::min(lat.size() - 1, lat.size() * 99 / 100)]);
+    }
+    return 0;
+}
+
+// Lepton CCI control path end to end through the SDK, against the in-process
+// simulator at 400 kHz bus timing: latency, status polls and bus transfers per
+// command, then how injected bus and command faults surface.
+static LEP_CAMERA_PORT_DESC_T s_cciPort;
+
+static LEP_RESULT cciGetAgc()
+{
+    LEP_AGC_ENABLE_E e;
+    return LEP_GetAgcEnableState(&s_cciPort, &e);
+}
+
+static LEP_RESULT cciSetAgc()
+{
+    return LEP_SetAgcEnableState(&s_cciPort, LEP_AGC_ENABLE);
+}
+
+static LEP_RESULT cciGetFpaTemp()
+{
+    LEP_SYS_FPA_TEMPERATURE_KELVIN_T k;
+    return LEP_GetSysFpaTemperatureKelvin(&s_cciPort, &k);
+}
+
+static LEP_RESULT cciFfc()
+{
+    return LEP_RunSysFFCNormalization(&s_cciPort);
+}
+
+static int benchCci()
+{
+    DEV_I2C_SetBackend(SIM_I2C_GetBackend());
+    SIM_I2C_Reset();
+    SIM_I2C_CONFIG_T defaults;
+    SIM_I2C_GetConfig(&defaults);
+    if (LEP_OpenPort(1, LEP_CCI_TWI, 400, &s_cciPort) != LEP_OK) {
+        fprintf(stderr, "cci: cannot open the simulated port\n");
+        return 1;
+    }
+
+    struct Case { const char* name; LEP_RESULT (*fn)(); LEP_I2C_POLL_CLASS_E poll; int n; };
+    const Case cases[] = {
+        { "get agc",   cciGetAgc,     LEP_I2C_POLL_GET,  200 },
+        { "set agc",   cciSetAgc,     LEP_I2C_POLL_SET,  200 },
+        { "get fpa k", cciGetFpaTemp, LEP_I2C_POLL_GET,  200 },
+        { "run ffc",   cciFfc,        LEP_I2C_POLL_LONG, 5 },
+    };
+
+    printf("cci: simulated Lepton, %u kHz bus\n", defaults.busKHz);
+    printf("%-10s %8s %10s %10s %8s %8s\n", "command", "n", "avg ms", "max ms", "polls", "xfers");
+    for (const Case& c : cases) {
+        LEP_I2C_ResetPollStats();
+        SIM_I2C_Reset();
+        double maxMs = 0, total = 0;
+        int failed = 0;
+        for (int i = 0; i < c.n; ++i) {
+            double t0 = wallMs();
+            if (c.fn() != LEP_OK) failed++;
+            double ms = wallMs() - t0;
+            total += ms;
+            maxMs = std::max(maxMs, ms);
+        }
+        LEP_I2C_POLL_STATS_T ps;
+        LEP_I2C_GetPollStats(c.poll, &ps);
+        SIM_I2C_STATS_T ss;
+        SIM_I2C_GetStats(&ss);
+        printf("%-10s %8d %10.3f %10.3f %8.1f %8.1f\n", c.name, c.n, total / c.n, maxMs,
+               ps.waits ? (double)ps.polls / ps.waits : 0.0, (double)(ss.reads + ss.writes) / c.n);
+        if (failed) { fprintf(stderr, "%s: %d failures with no faults injected\n", c.name, failed); return 1; }
+    }
+
+    // 512-word user LUT through the block data buffer, in register-sized
+    // pieces, in larger pieces, and as one transfer each way
+    LEP_VID_LUT_BUFFER_T lut;
+    for (int i = 0; i < 256; ++i) {
+        lut.bin[i].reserved = 0;
+        lut.bin[i].red = (LEP_UINT8)i;
+        lut.bin[i].green = (LEP_UINT8)(255 - i);
+        lut.bin[i].blue = (LEP_UINT8)(i / 2);
+    }
+    printf("\nuser LUT, %d words, 20 x set + get each\n", (int)(sizeof(lut) / 2));
+    printf("%-12s %10s %10s %8s\n", "transfer", "set ms", "get ms", "xfers");
+    const int pieces[] = { 16, 64, 0 };
+    for (int words : pieces) {
+        LEP_I2C_SetBlockTransferWords((LEP_UINT16)words);
+        SIM_I2C_Reset();
+        double setMs = 0, getMs = 0;
+        bool same = true;
+        for (int i = 0; i < 20; ++i) {
+            LEP_VID_LUT_BUFFER_T back;
+            double t0 = wallMs();
+            LEP_RESULT rs = LEP_SetVidUserLut(&s_cciPort, &lut);
+            double t1 = wallMs();
+            LEP_RESULT rg = LEP_GetVidUserLut(&s_cciPort, &back);
+            double t2 = wallMs();
+            setMs += t1 - t0;
+            getMs += t2 - t1;
+            same = same && rs == LEP_OK && rg == LEP_OK && memcmp(&lut, &back, sizeof(lut)) == 0;
+        }
+        SIM_I2C_STATS_T ss;
+        SIM_I2C_GetStats(&ss);
+        char label[16];
+        if (words) snprintf(label, sizeof(label), "%d words", words);
+        else snprintf(label, sizeof(label), "single");
+        printf("%-12s %10.3f %10.3f %8.1f\n", label, setMs / 20, getMs / 20, (ss.reads + ss.writes) / 40.0);
+        if (!same) { fprintf(stderr, "user LUT did not read back intact\n"); return 1; }
+    }
+    LEP_I2C_SetBlockTransferWords(0);
+
+    printf("\nfaults: 500 x get agc each\n");
+    printf("%-22s %6s %8s %8s %8s\n", "injected", "ok", "bus err", "status", "other");
+    const struct { const char* name; unsigned nack, error; } faults[] = {
+        { "none",               0, 0 },
+        { "nack every 50 xfers", 50, 0 },
+        { "error every 10 cmds", 0, 10 },
+    };
+    for (const auto& f : faults) {
+        SIM_I2C_CONFIG_T cfg = defaults;
+        cfg.nackEvery = f.nack;
+        cfg.errorEvery = f.error;
+        cfg.errorCode = LEP_RANGE_ERROR;
+        SIM_I2C_SetConfig(&cfg);
+        SIM_I2C_Reset();
+        int ok = 0, bus = 0, status = 0, other = 0;
+        for (int i = 0; i < 500; ++i) {
+            LEP_RESULT r = cciGetAgc();
+            if (r == LEP_OK) ok++;
+            else if (r == LEP_ERROR_I2C_FAIL || r == LEP_ERROR) bus++;
+            else if (r == LEP_RANGE_ERROR) status++;
+            else other++;
+        }
+        printf("%-22s %6d %8d %8d %8d\n", f.name, ok, bus, status, other);
+    }
+
+    // a command that never completes: how long until the caller hears about it
+    SIM_I2C_CONFIG_T stuck = defaults;
+    stuck.getBusyUs = 60 * 1000000u;
+    SIM_I2C_SetConfig(&stuck);
+    SIM_I2C_Reset();
+    LEP_I2C_ResetPollStats();
+    double t0 = wallMs();
+    LEP_RESULT r = cciGetAgc();
+    double ms = wallMs() - t0;
+    LEP_I2C_POLL_STATS_T ps;
+    LEP_I2C_GetPollStats(LEP_I2C_POLL_GET, &ps);
+    printf("\nstuck busy: result %d after %.0f ms, %u status polls\n", (int)r, ms, ps.polls);
+
+    SIM_I2C_SetConfig(&defaults);
+    DEV_I2C_SetBackend(nullptr);
+    return r == LEP_TIMEOUT_ERROR ? 0 : 1;
+}
+
+int runBench(const char* name)
+{
+    if (strcmp(name, "edges") == 0) return benchEdges();
+    if (strcmp(name, "httpparse") == 0) return benchHttpParse();
+    if (strcmp(name, "cci") == 0) return benchCci();
+    if (strcmp(name, "tone") == 0) return benchTone();
+    if (strcmp(name, "range") == 0) return benchRange();
+    if (strcmp(name, "http") == 0) return benchHttpLoad(nullptr);
+    if (strncmp(name, "http=", 5) == 0) return benchHttpLoad(name + 5);
+
+    fprintf(stderr, "unknown benchmark '%s' (available: edges, tone, range, httpparse, cci, http[=host:port])\n", name);
+    return 1;
+}
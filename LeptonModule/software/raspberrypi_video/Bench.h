@@ -0,0 +1,7 @@
+#pragma once
+
+// Offline micro-benchmarks, run with `raspberrypi_video -bench <name>`.
+// They use synthetic input so they work without a Lepton or camera attached;
+// "cci" runs the SDK against the simulated camera in sim_I2C.c.
+// "http[=host:port]" is a small load generator for a running instance.
+int runBench(const char* name);
@@ -0,0 +1,247 @@
+#include "CciWorker.h"
+#include "Lepton_I2C.h"
+#include "leptonSDKEmb32PUB/LEPTON_I2C_Protocol.h"
+
+#include <QMutexLocker>
+
+// Busy-bit polling inside the SDK, per command class. The counters are
+// plain data written by the thread on the bus, so this runs on the worker
+// between commands and statsJson() hands out the copy.
+static QJsonObject pollStatsJson()
+{
+    static const char* const names[LEP_I2C_END_POLL_CLASS] = { "ready", "get", "set", "run", "long" };
+    QJsonObject poll;
+    for (int c = 0; c < LEP_I2C_END_POLL_CLASS; ++c) {
+        LEP_I2C_POLL_STATS_T ps;
+        if (LEP_I2C_GetPollStats((LEP_I2C_POLL_CLASS_E)c, &ps) != LEP_OK) continue;
+        QJsonObject p;
+        p["waits"] = (double)ps.waits;
+        p["polls"] = (double)ps.polls;
+        p["avg_polls"] = ps.waits ? (double)ps.polls / ps.waits : 0.0;
+        p["max_polls"] = (double)ps.maxPolls;
+        p["last_polls"] = (double)ps.lastPolls;
+        p["timeouts"] = (double)ps.timeouts;
+        p["max_wait_us"] = (double)ps.maxWaitUs;
+        p["last_wait_us"] = (double)ps.lastWaitUs;
+        poll[names[c]] = p;
+    }
+    return poll;
+}
+
+CciWorker::CciWorker(QObject* parent) : QThread(parent)
+{
+    m_clock.start();
+    m_dog = std::thread([this]() { watchdog(); });
+}
+
+CciWorker::~CciWorker()
+{
+    stop();
+    wait();
+    if (m_dog.joinable()) m_dog.join();
+}
+
+void CciWorker::stop()
+{
+    QMutexLocker lk(&m_mtx);
+    m_stop = true;
+    m_cond.wakeAll();
+    m_dogCond.wakeAll();
+}
+
+std::shared_future<CciWorker::Result> CciWorker::ffc(Callback cb)
+{
+    return submit("ffc", []() { return lepton_perform_ffc(); }, 3000, cb);
+}
+
+std::shared_future<CciWorker::Result> CciWorker::reboot(Callback cb)
+{
+    return submit("reboot", []() { return lepton_reboot(); }, 5000, cb);
+}
+
+std::shared_future<CciWorker::Result> CciWorker::setAgc(int policy, Callback cb)
+{
+    static const char* const ops[] = { "agc_off", "agc_linear", "agc_heq" };
+    policy = qBound(0, policy, 2);
+    return submit(ops[policy], [policy]() { return lepton_set_agc(policy); }, 2000, cb);
+}
+
+std::shared_future<CciWorker::Result> CciWorker::setVideoFormat(bool rgb888, int agcPolicy,
+                                                                const std::vector<unsigned int>& lut,
+                                                                Callback cb)
+{
+    if (!rgb888) return submit("video_raw14", []() { return lepton_set_raw14(); }, 2000, cb);
+    // the LUT upload is 512 words through the block buffer
+    return submit("video_rgb888", [agcPolicy, lut]() { return lepton_set_rgb888(agcPolicy, lut.data()); },
+                  3000, cb);
+}
+
+std::shared_future<CciWorker::Result> CciWorker::submit(const QString& op, Command fn,
+                                                        int timeoutMs, Callback cb)
+{
+    QMutexLocker lk(&m_mtx);
+    m_submitted++;
+
+    // join a pending or running request for the same op
+    JobPtr same;
+    if (m_running && m_running->op == op && !m_running->done) same = m_running;
+    for (const JobPtr& j : m_queue)
+        if (!same && j->op == op && !j->done) same = j;
+    if (same) {
+        m_coalesced++;
+        if (cb) same->callbacks.append(qMakePair(cb, true));
+        return same->future;
+    }
+
+    JobPtr job = std::make_shared<Job>();
+    job->op = op;
+    job->fn = fn;
+    job->timeoutMs = timeoutMs;
+    job->submittedMs = m_clock.elapsed();
+    job->deadlineMs = job->submittedMs + timeoutMs;
+    job->promise = std::make_shared<std::promise<Result>>();
+    job->future = job->promise->get_future().share();
+    if (cb) job->callbacks.append(qMakePair(cb, false));
+
+    m_queue.append(job);
+    m_cond.wakeOne();
+    m_dogCond.wakeAll();
+    return job->future;
+}
+
+bool CciWorker::complete(const JobPtr& job, Result r, Fired* out)
+{
+    if (job->done) return false; // a timeout already answered, or the other way round
+    job->done = true;
+    r.op = job->op;
+    r.ms = m_clock.elapsed() - job->submittedMs;
+
+    m_completed++;
+    if (r.timedOut) m_timeouts++;
+    else if (!r.ok) m_failed++;
+    m_last.insert(job->op, r);
+
+    job->promise->set_value(r);
+    out->result = r;
+    out->callbacks = job->callbacks;
+    return true;
+}
+
+void CciWorker::fire(const QList<Fired>& fired)
+{
+    for (const Fired& f : fired) {
+        for (const auto& cb : f.callbacks) {
+            Result c = f.result;
+            c.coalesced = cb.second;
+            cb.first(c);
+        }
+        emit finished(f.result.op, f.result.status, f.result.ok, f.result.timedOut);
+    }
+}
+
+void CciWorker::run()
+{
+    QMutexLocker lk(&m_mtx);
+    for (;;) {
+        while (m_queue.isEmpty() && !m_stop) m_cond.wait(&m_mtx);
+        if (m_stop) break;
+
+        JobPtr job = m_queue.takeFirst();
+        if (job->done) continue; // expired in the queue, already answered
+
+        m_running = job;
+        m_dogCond.wakeAll();
+        lk.unlock();
+        int status = job->fn();
+        QJsonObject poll = pollStatsJson();
+        lk.relock();
+        m_poll = poll;
+
+        Result r;
+        r.status = status;
+        r.ok = (status == 0);
+        Fired f;
+        bool fresh = complete(job, r, &f);
+        m_running.reset();
+        m_dogCond.wakeAll();
+        if (fresh) {
+            lk.unlock();
+            fire({ f });
+            lk.relock();
+        }
+    }
+
+    // release anyone still waiting
+    QList<Fired> fired;
+    for (const JobPtr& job : m_queue) {
+        Result r;
+        r.timedOut = true;
+        Fired f;
+        if (complete(job, r, &f)) fired.append(f);
+    }
+    m_queue.clear();
+    lk.unlock();
+    fire(fired);
+}
+
+// Answers commands whose deadline has passed, queued or running. A running
+// bus call keeps going on the worker; its late result is dropped.
+void CciWorker::watchdog()
+{
+    QMutexLocker lk(&m_mtx);
+    while (!m_stop) {
+        qint64 now = m_clock.elapsed();
+        qint64 next = -1;
+        QList<Fired> fired;
+
+        QList<JobPtr> jobs = m_queue;
+        if (m_running) jobs.prepend(m_running);
+        for (const JobPtr& j : jobs) {
+            if (j->done) continue;
+            if (j->deadlineMs <= now) {
+                Result r;
+                r.timedOut = true;
+                Fired f;
+                if (complete(j, r, &f)) fired.append(f);
+            } else if (next < 0 || j->deadlineMs < next) {
+                next = j->deadlineMs;
+            }
+        }
+
+        if (!fired.isEmpty()) {
+            lk.unlock();
+            fire(fired);
+            lk.relock();
+            continue;
+        }
+        if (next < 0) m_dogCond.wait(&m_mtx);
+        else m_dogCond.wait(&m_mtx, (unsigned long)(next - now));
+    }
+}
+
+QJsonObject CciWorker::statsJson() const
+{
+    QMutexLocker lk(&m_mtx);
+    QJsonObject o;
+    o["submitted"] = (double)m_submitted;
+    o["coalesced"] = (double)m_coalesced;
+    o["completed"] = (double)m_completed;
+    o["failed"] = (double)m_failed;
+    o["timeouts"] = (double)m_timeouts;
+    o["queued"] = m_queue.size();
+    o["running"] = m_running ? m_running->op : QString();
+
+    QJsonObject last;
+    for (auto it = m_last.constBegin(); it != m_last.constEnd(); ++it) {
+        QJsonObject r;
+        r["status"] = it->status;
+        r["ok"] = it->ok;
+        r["timed_out"] = it->timedOut;
+        r["ms"] = (double)it->ms;
+        last[it.key()] = r;
+    }
+    o["last"] = last;
+
+    o["poll"] = m_poll;
+    return o;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <QList>
+#include <QPair>
+#include <QHash>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Runs Lepton CCI (I2C) commands on one dedicated thread, so an FFC from
+// the UI or a reboot from the capture loop never blocks the caller.
+//
+// submit() returns a shared_future and optionally takes a callback; both
+// complete exactly once, with the SDK result or with a timeout. A request
+// for an op that is already queued or running is coalesced into it. The
+// SDK call itself cannot be interrupted: on timeout the caller is released
+// and the late result is dropped.
+class CciWorker : public QThread
+{
+    Q_OBJECT
+public:
+    struct Result {
+        QString op;
+        int status = 0;         // LEP_RESULT, 0 = LEP_OK
+        bool ok = false;
+        bool timedOut = false;
+        bool coalesced = false; // the caller joined an earlier request
+        qint64 ms = 0;          // queue wait + execution
+    };
+    typedef std::function<int()> Command;               // returns a LEP_RESULT
+    typedef std::function<void(const Result&)> Callback; // on worker/watchdog thread
+
+    explicit CciWorker(QObject* parent = nullptr);
+    ~CciWorker() override;
+
+    std::shared_future<Result> submit(const QString& op, Command fn,
+                                      int timeoutMs = 2000, Callback cb = Callback());
+
+    std::shared_future<Result> ffc(Callback cb = Callback());
+    std::shared_future<Result> reboot(Callback cb = Callback());
+    // policy as lepton_set_agc(); each policy is its own op, so the last one wins
+    std::shared_future<Result> setAgc(int policy, Callback cb = Callback());
+    // RGB888 with the given 256-entry user LUT, or back to RAW14; a request
+    // coalesced into a pending one runs with that one's LUT
+    std::shared_future<Result> setVideoFormat(bool rgb888, int agcPolicy,
+                                              const std::vector<unsigned int>& lut,
+                                              Callback cb = Callback());
+
+    void stop();
+    QJsonObject statsJson() const;
+
+signals:
+    // queued to receivers in other threads; the Qt-side way to get results
+    void finished(QString op, int status, bool ok, bool timedOut);
+
+protected:
+    void run() override;
+
+private:
+    struct Job {
+        QString op;
+        Command fn;
+        int timeoutMs = 0;
+        qint64 submittedMs = 0;
+        qint64 deadlineMs = 0;
+        std::shared_ptr<std::promise<Result>> promise;
+        std::shared_future<Result> future;
+        QList<QPair<Callback, bool>> callbacks; // and whether it joined late
+        bool done = false;
+    };
+    typedef std::shared_ptr<Job> JobPtr;
+
+    struct Fired {
+        Result result;
+        QList<QPair<Callback, bool>> callbacks;
+    };
+    // marks job done and fulfils the future (m_mtx held); the returned
+    // callbacks are run by fire() after the lock is released
+    bool complete(const JobPtr& job, Result r, Fired* out);
+    void fire(const QList<Fired>& fired);
+    void watchdog();
+
+    mutable QMutex m_mtx;
+    QWaitCondition m_cond;      // worker: new job or stop
+    QWaitCondition m_dogCond;   // watchdog: job started, finished or stop
+    QList<JobPtr> m_queue;
+    JobPtr m_running;
+    bool m_stop = false;
+    QElapsedTimer m_clock;
+    std::thread m_dog;
+
+    // stats
+    quint64 m_submitted = 0;
+    quint64 m_coalesced = 0;
+    quint64 m_completed = 0;
+    quint64 m_failed = 0;
+    quint64 m_timeouts = 0;
+    QHash<QString, Result> m_last;
+    QJsonObject m_poll;         // SDK busy-poll counters after the last command
+};
@@ -81,13 +81,16 @@ bool CmdServer::applyLine(const QString& line)
     // Commands:
     // set <camera|thermal> <offset_x|offset_y|rotate_deg|scale|opacity|flip_h|flip_v> <value>
     // bg <black|grey>
+    // ffc | reboot   (forwarded to the CCI worker, no config change)
 
     QStringList t = line.split(' ', Qt::SkipEmptyParts);
     if (t.isEmpty()) return false;
 
     bool changed = false;
 
-    if (t[0] == "bg" && t.size() >= 2 && m_cfg) {
+    if (t[0] == "ffc" || t[0] == "reboot") {
+        emit cciRequested(t[0]);
+    } else if (t[0] == "bg" && t.size() >= 2 && m_cfg) {
         QString v = t[1].toLower();
         if (v == "black" || v == "grey") {
             if (m_cfg->background != v) {
@@ -95,6 +98,27 @@ bool CmdServer::applyLine(const QString& line)
                 changed = true;
             }
         }
+    } else if (t[0] == "set" && t.size() >= 4 && m_cfg && t[1].toLower() == "display") {
+        QString key = t[2].toLower();
+        if (key == "fps") { m_cfg->display.fps = qBound(1, t[3].toInt(), 120); changed = true; }
+    } else if (t[0] == "set" && t.size() >= 4 && m_cfg && t[1].toLower() == "stream") {
+        QString key = t[2].toLower();
+        QString val = t[3];
+        if (key == "quality") { m_cfg->stream.quality = qBound(1, val.toInt(), 100); changed = true; }
+        else if (key == "max_buffered_kb") { m_cfg->stream.max_buffered_kb = qBound(16, val.toInt(), 8192); changed = true; }
+        else if (key == "subsampling" && (val == "420" || val == "422" || val == "444")) {
+            m_cfg->stream.subsampling = val; changed = true;
+        }
+    } else if (t[0] == "set" && t.size() >= 4 && m_cfg && t[1].toLower() == "ffc") {
+        QString key = t[2].toLower();
+        QString val = t[3].toLower();
+        if (key == "mode" && (val == "auto" || val == "scheduled" || val == "manual")) {
+            m_cfg->ffc.mode = val; changed = true;
+        }
+        else if (key == "period_s") { m_cfg->ffc.period_s = qBound(10, val.toInt(), 3600); changed = true; }
+        else if (key == "temp_delta") { m_cfg->ffc.temp_delta = qBound(0.1, val.toDouble(), 10.0); changed = true; }
+        else if (key == "max_defer_s") { m_cfg->ffc.max_defer_s = qBound(0, val.toInt(), 600); changed = true; }
+        else if (key == "quiet") { m_cfg->ffc.quiet = qBound(0.0, val.toDouble(), 1.0); changed = true; }
     } else if (t[0] == "set" && t.size() >= 4 && m_cfg) {
         QString src = t[1].toLower();
         QString key = t[2].toLower();
@@ -114,7 +138,66 @@ bool CmdServer::applyLine(const QString& line)
             m_cfg->usb.emboss = (val == "1" || val == "true" || val == "on");
             changed = true;
         }
+        else if (key == "emboss_threshold" && (src == "camera" || src == "usb" || src == "usb_cam")) {
+            m_cfg->usb.emboss_threshold = qBound(1, val.toInt(), 255);
+            changed = true;
+        }
+        else if (key == "emboss_thin" && (src == "camera" || src == "usb" || src == "usb_cam")) {
+            m_cfg->usb.emboss_thin = (val == "1" || val == "true" || val == "on");
+            changed = true;
+        }
+        else if (key == "emboss_size" && (src == "camera" || src == "usb" || src == "usb_cam")) {
+            // WxH, or 0 for the capture size
+            QStringList wh = val.toLower().split('x');
+            m_cfg->usb.emboss_width  = qMax(0, wh.value(0).toInt());
+            m_cfg->usb.emboss_height = qMax(0, wh.value(1, wh.value(0)).toInt());
+            changed = true;
+        }
         else if (key == "smooth" && src == "thermal") { m_cfg->thermal.smooth = val.toInt(); changed = true; }
+        else if (key == "agc" && src == "thermal") {
+            if (val != "pi" && val != "linear" && val != "heq") {
+                qDebug() << "CmdServer: agc must be pi, linear or heq:" << val;
+                return false;
+            }
+            m_cfg->thermal.agc = val;
+            changed = true;
+        }
+        else if (key == "video" && src == "thermal") {
+            if (val != "raw" && val != "rgb888") {
+                qDebug() << "CmdServer: video must be raw or rgb888:" << val;
+                return false;
+            }
+            m_cfg->thermal.video = val;
+            changed = true;
+        }
+        else if (key == "tone" && src == "thermal") {
+            if (val != "linear" && val != "heq" && val != "plateau" && val != "clahe") {
+                qDebug() << "CmdServer: tone must be linear, heq, plateau or clahe:" << val;
+                return false;
+            }
+            m_cfg->thermal.tone = val;
+            changed = true;
+        }
+        else if (key == "tone_plateau" && src == "thermal") {
+            m_cfg->thermal.tone_plateau = qBound(0.1, val.toDouble(), 100.0);
+            changed = true;
+        }
+        else if (key == "tone_clip" && src == "thermal") {
+            m_cfg->thermal.tone_clip = qBound(1.0, val.toDouble(), 64.0);
+            changed = true;
+        }
+        else if (key == "range_clip" && src == "thermal") {
+            m_cfg->thermal.range_clip = qBound(0.0, val.toDouble(), 10.0);
+            changed = true;
+        }
+        else if (key == "range_smooth" && src == "thermal") {
+            m_cfg->thermal.range_smooth = qBound(0.01, val.toDouble(), 1.0);
+            changed = true;
+        }
+        else if (key == "range_hysteresis" && src == "thermal") {
+            m_cfg->thermal.range_hysteresis = qBound(0.0, val.toDouble(), 0.5);
+            changed = true;
+        }
     } else {
         qDebug() << "CmdServer: unknown cmd:" << line;
         return false;
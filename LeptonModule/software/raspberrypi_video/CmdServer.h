@@ -14,6 +14,8 @@ public:
 
 signals:
     void configChanged();
+    // "ffc" / "reboot": camera commands, not config
+    void cciRequested(QString op);
 
 private slots:
     void onReadyRead();
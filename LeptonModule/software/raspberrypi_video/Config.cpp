@@ -62,6 +62,10 @@ bool ConfigIO::load(const QString& path, AppCfg& out) {
         out.usb.height  = jInt(u, "height", out.usb.height);
         out.usb.fps     = jInt(u, "fps", out.usb.fps);
         out.usb.emboss  = jBool(u, "emboss", out.usb.emboss);
+        out.usb.emboss_threshold = jInt(u, "emboss_threshold", out.usb.emboss_threshold);
+        out.usb.emboss_thin      = jBool(u, "emboss_thin", out.usb.emboss_thin);
+        out.usb.emboss_width     = jInt(u, "emboss_width", out.usb.emboss_width);
+        out.usb.emboss_height    = jInt(u, "emboss_height", out.usb.emboss_height);
         loadLayer(u, out.usb.xform);
     }
 
@@ -69,10 +73,42 @@ bool ConfigIO::load(const QString& path, AppCfg& out) {
         auto t = root["thermal"].toObject();
         out.thermal.enabled = jBool(t, "enabled", out.thermal.enabled);
         out.thermal.smooth  = jInt(t, "smooth", out.thermal.smooth);
+        out.thermal.agc     = jStr(t, "agc", out.thermal.agc);
+        out.thermal.video   = jStr(t, "video", out.thermal.video);
+        out.thermal.tone    = jStr(t, "tone", out.thermal.tone);
+        out.thermal.tone_plateau = jDbl(t, "tone_plateau", out.thermal.tone_plateau);
+        out.thermal.tone_clip    = jDbl(t, "tone_clip", out.thermal.tone_clip);
+        out.thermal.range_clip   = jDbl(t, "range_clip", out.thermal.range_clip);
+        out.thermal.range_smooth = jDbl(t, "range_smooth", out.thermal.range_smooth);
+        out.thermal.range_hysteresis = jDbl(t, "range_hysteresis", out.thermal.range_hysteresis);
         loadLayer(t, out.thermal.xform);
         out.thermal.xform.opacity = jDbl(t, "opacity", out.thermal.xform.opacity);
     }
 
+    if (root.contains("display") && root["display"].isObject()) {
+        auto d = root["display"].toObject();
+        out.display.fps = jInt(d, "fps", out.display.fps);
+    }
+
+    if (root.contains("stream") && root["stream"].isObject()) {
+        auto s = root["stream"].toObject();
+        out.stream.quality     = jInt(s, "quality", out.stream.quality);
+        out.stream.subsampling = jStr(s, "subsampling", out.stream.subsampling);
+        out.stream.max_buffered_kb = jInt(s, "max_buffered_kb", out.stream.max_buffered_kb);
+    }
+
+    if (root.contains("ffc") && root["ffc"].isObject()) {
+        auto f = root["ffc"].toObject();
+        // anything but auto switches the camera's own FFC off, so a typo
+        // must not get that far
+        QString mode        = jStr(f, "mode", out.ffc.mode);
+        if (mode == "auto" || mode == "scheduled" || mode == "manual") out.ffc.mode = mode;
+        out.ffc.period_s    = jInt(f, "period_s", out.ffc.period_s);
+        out.ffc.temp_delta  = jDbl(f, "temp_delta", out.ffc.temp_delta);
+        out.ffc.max_defer_s = jInt(f, "max_defer_s", out.ffc.max_defer_s);
+        out.ffc.quiet       = jDbl(f, "quiet", out.ffc.quiet);
+    }
+
     return true;
 }
 
@@ -89,6 +125,10 @@ bool ConfigIO::save(const QString& path, const AppCfg& in) {
     u["height"] = in.usb.height;
     u["fps"] = in.usb.fps;
     u["emboss"] = in.usb.emboss;
+    u["emboss_threshold"] = in.usb.emboss_threshold;
+    u["emboss_thin"] = in.usb.emboss_thin;
+    u["emboss_width"] = in.usb.emboss_width;
+    u["emboss_height"] = in.usb.emboss_height;
     auto ux = saveLayer(in.usb.xform);
     for (auto it = ux.begin(); it != ux.end(); ++it) u[it.key()] = it.value();
     root["usb_cam"] = u;
@@ -96,11 +136,37 @@ bool ConfigIO::save(const QString& path, const AppCfg& in) {
     QJsonObject t;
     t["enabled"] = in.thermal.enabled;
     t["smooth"] = in.thermal.smooth;
+    t["agc"] = in.thermal.agc;
+    t["video"] = in.thermal.video;
+    t["tone"] = in.thermal.tone;
+    t["tone_plateau"] = in.thermal.tone_plateau;
+    t["tone_clip"] = in.thermal.tone_clip;
+    t["range_clip"] = in.thermal.range_clip;
+    t["range_smooth"] = in.thermal.range_smooth;
+    t["range_hysteresis"] = in.thermal.range_hysteresis;
     auto tx = saveLayer(in.thermal.xform);
     for (auto it = tx.begin(); it != tx.end(); ++it) t[it.key()] = it.value();
     t["opacity"] = in.thermal.xform.opacity;
     root["thermal"] = t;
 
+    QJsonObject d;
+    d["fps"] = in.display.fps;
+    root["display"] = d;
+
+    QJsonObject s;
+    s["quality"] = in.stream.quality;
+    s["subsampling"] = in.stream.subsampling;
+    s["max_buffered_kb"] = in.stream.max_buffered_kb;
+    root["stream"] = s;
+
+    QJsonObject f;
+    f["mode"] = in.ffc.mode;
+    f["period_s"] = in.ffc.period_s;
+    f["temp_delta"] = in.ffc.temp_delta;
+    f["max_defer_s"] = in.ffc.max_defer_s;
+    f["quiet"] = in.ffc.quiet;
+    root["ffc"] = f;
+
     QJsonDocument doc(root);
     QByteArray bytes = doc.toJson(QJsonDocument::Indented);
 
@@ -18,19 +18,52 @@ struct UsbCamCfg {
     int height = 480;
     int fps = 15;
     bool emboss = false;
+    int emboss_threshold = 35; // (|gx|+|gy|)/8, tune 10..80
+    bool emboss_thin = false;  // Canny-style thin edges
+    int emboss_width = 0;      // edge working resolution, 0 = capture size
+    int emboss_height = 0;
     LayerCfg xform;
 };
 
 struct ThermalCfg {
     bool enabled = true;
     int smooth = 0; // 0=off, higher=stronger
+    QString agc = "pi"; // "pi" maps raw 14-bit here, "linear"/"heq" use the camera AGC (8-bit video)
+    QString video = "raw"; // "rgb888": the camera applies the palette, needs AGC (pi means heq)
+    QString tone = "linear";  // Pi-side mapping: "linear" min/max, "heq", "plateau" or "clahe"
+    double tone_plateau = 5.0; // plateau: max percent of pixels per histogram bin
+    double tone_clip = 3.0;    // clahe: clip limit, multiple of the mean bin count
+    double range_clip = 0.05;      // linear auto range: percent of outliers ignored at each end
+    double range_smooth = 0.25;    // ... weight of the newest frame, 1 = no smoothing
+    double range_hysteresis = 0.02; // ... share of the span it must move before the palette follows
     LayerCfg xform;
 };
 
+struct DisplayCfg {
+    int fps = 30; // composite rate; source updates are coalesced to this
+};
+
+struct StreamCfg {
+    int quality = 70;             // MJPEG quality 1..100
+    QString subsampling = "420";  // chroma: "420", "422" or "444"
+    int max_buffered_kb = 256;    // per client send queue cap, frames are skipped above it
+};
+
+struct FfcCfg {
+    QString mode = "auto";      // "auto": camera schedule, "scheduled": FfcController, "manual": on request only
+    int period_s = 180;         // FFC at least this often
+    double temp_delta = 1.5;    // ... or when the FPA drifted this many kelvin
+    int max_defer_s = 30;       // a due FFC waits this long at most for a quiet scene
+    double quiet = 0.02;        // scene change per frame below which FFC may run, 0..1 of the range
+};
+
 struct AppCfg {
     QString background = "black"; // "black" or "grey"
     UsbCamCfg usb;
     ThermalCfg thermal;
+    DisplayCfg display;
+    StreamCfg stream;
+    FfcCfg ffc;
 };
 
 class ConfigIO {
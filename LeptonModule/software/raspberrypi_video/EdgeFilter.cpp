@@ -0,0 +1,211 @@
+#include "EdgeFilter.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define EDGE_NEON 1
+#endif
+
+// tan(22.5) and tan(67.5) in 8.8 fixed point, for gradient direction bins
+static const int TAN22_Q8 = 106;
+static const int TAN67_Q8 = 618;
+
+enum { DIR_H = 0, DIR_DIAG_DOWN = 1, DIR_V = 2, DIR_DIAG_UP = 3 };
+
+static void extractY(const uint8_t* yuyv, uint8_t* y, int w)
+{
+    int x = 0;
+#ifdef EDGE_NEON
+    for (; x + 16 <= w; x += 16) {
+        uint8x16x2_t v = vld2q_u8(yuyv + 2 * x); // val[0] = Y, val[1] = U/V
+        vst1q_u8(y + x, v.val[0]);
+    }
+#endif
+    for (; x < w; ++x) y[x] = yuyv[2 * x];
+}
+
+void EdgeFilter::setThreshold(int thr)
+{
+    m_thr8 = std::max(1, std::min(255, thr)) * 8;
+}
+
+void EdgeFilter::setThin(bool thin)
+{
+    m_thin = thin;
+}
+
+// Binary Sobel: d[x] = 255 when |gx| + |gy| >= thr * 8 (no division per pixel).
+void EdgeFilter::sobelRow(const uint8_t* p0, const uint8_t* p1, const uint8_t* p2,
+                          uint8_t* d, int w) const
+{
+    d[0] = 0;
+    int x = 1;
+#ifdef EDGE_NEON
+    const uint16x8_t thr = vdupq_n_u16((uint16_t)m_thr8);
+    for (; x + 9 <= w; x += 8) {
+        uint8x8_t a0 = vld1_u8(p0 + x - 1), b0 = vld1_u8(p0 + x), c0 = vld1_u8(p0 + x + 1);
+        uint8x8_t a1 = vld1_u8(p1 + x - 1),                        c1 = vld1_u8(p1 + x + 1);
+        uint8x8_t a2 = vld1_u8(p2 + x - 1), b2 = vld1_u8(p2 + x), c2 = vld1_u8(p2 + x + 1);
+
+        // gx = right column - left column, each smoothed 1-2-1 vertically
+        uint16x8_t vl = vaddq_u16(vaddl_u8(a0, a2), vshll_n_u8(a1, 1));
+        uint16x8_t vr = vaddq_u16(vaddl_u8(c0, c2), vshll_n_u8(c1, 1));
+        int16x8_t gx = vsubq_s16(vreinterpretq_s16_u16(vr), vreinterpretq_s16_u16(vl));
+
+        // gy = bottom row - top row, each smoothed 1-2-1 horizontally
+        uint16x8_t ht = vaddq_u16(vaddl_u8(a0, c0), vshll_n_u8(b0, 1));
+        uint16x8_t hb = vaddq_u16(vaddl_u8(a2, c2), vshll_n_u8(b2, 1));
+        int16x8_t gy = vsubq_s16(vreinterpretq_s16_u16(hb), vreinterpretq_s16_u16(ht));
+
+        uint16x8_t mag = vreinterpretq_u16_s16(vaddq_s16(vabsq_s16(gx), vabsq_s16(gy)));
+        vst1_u8(d + x, vmovn_u16(vcgeq_u16(mag, thr)));
+    }
+#endif
+    for (; x < w - 1; ++x) {
+        int gx = (p0[x+1] + 2*p1[x+1] + p2[x+1]) - (p0[x-1] + 2*p1[x-1] + p2[x-1]);
+        int gy = (p2[x-1] + 2*p2[x] + p2[x+1]) - (p0[x-1] + 2*p0[x] + p0[x+1]);
+        d[x] = (std::abs(gx) + std::abs(gy) >= m_thr8) ? 255 : 0;
+    }
+    d[w - 1] = 0;
+}
+
+// Sobel magnitude plus a 4-bin gradient direction, for non-maximum suppression.
+void EdgeFilter::magRow(const uint8_t* p0, const uint8_t* p1, const uint8_t* p2,
+                        uint16_t* mag, uint8_t* dir, int w) const
+{
+    mag[0] = 0;
+    dir[0] = DIR_H;
+    for (int x = 1; x < w - 1; ++x) {
+        int gx = (p0[x+1] + 2*p1[x+1] + p2[x+1]) - (p0[x-1] + 2*p1[x-1] + p2[x-1]);
+        int gy = (p2[x-1] + 2*p2[x] + p2[x+1]) - (p0[x-1] + 2*p0[x] + p0[x+1]);
+        int ax = std::abs(gx);
+        int ay = std::abs(gy);
+        mag[x] = (uint16_t)(ax + ay);
+
+        if ((ay << 8) <= ax * TAN22_Q8)      dir[x] = DIR_H;
+        else if ((ay << 8) >= ax * TAN67_Q8) dir[x] = DIR_V;
+        else if ((gx ^ gy) >= 0)             dir[x] = DIR_DIAG_DOWN;
+        else                                 dir[x] = DIR_DIAG_UP;
+    }
+    mag[w - 1] = 0;
+    dir[w - 1] = DIR_H;
+}
+
+void EdgeFilter::suppressRow(const uint16_t* m0, const uint16_t* m1, const uint16_t* m2,
+                             const uint8_t* dir, uint8_t* d, int w) const
+{
+    d[0] = 0;
+    for (int x = 1; x < w - 1; ++x) {
+        int m = m1[x];
+        if (m < m_thr8) { d[x] = 0; continue; }
+
+        int a, b;
+        switch (dir[x]) {
+        case DIR_H:         a = m1[x-1]; b = m1[x+1]; break;
+        case DIR_V:         a = m0[x];   b = m2[x];   break;
+        case DIR_DIAG_DOWN: a = m0[x-1]; b = m2[x+1]; break;
+        default:            a = m0[x+1]; b = m2[x-1]; break;
+        }
+        // strict on one side so flat ridges stay one pixel wide
+        d[x] = (m > a && m >= b) ? 255 : 0;
+    }
+    d[w - 1] = 0;
+}
+
+// Produce Y row r of the working-resolution plane. At native size this is a
+// straight deinterleave; otherwise each output pixel is the mean of the source
+// box it covers, accumulated one source row at a time.
+void EdgeFilter::fetchRow(int r, uint8_t* y)
+{
+    if (m_outW == m_srcW && m_outH == m_srcH) {
+        extractY(m_src + r * m_srcStride, y, m_outW);
+        return;
+    }
+
+    int y0 = r * m_srcH / m_outH;
+    int y1 = (r + 1) * m_srcH / m_outH;
+    uint32_t* acc = m_acc.data();
+    std::fill(acc, acc + m_srcW, 0);
+    for (int sy = y0; sy < y1; ++sy) {
+        const uint8_t* s = m_src + sy * m_srcStride;
+        for (int x = 0; x < m_srcW; ++x) acc[x] += s[2 * x];
+    }
+
+    for (int ox = 0; ox < m_outW; ++ox) {
+        int xs = m_xSpan[ox];
+        int xe = m_xSpan[ox + 1];
+        uint32_t sum = 0;
+        for (int x = xs; x < xe; ++x) sum += acc[x];
+        y[ox] = (uint8_t)(sum / (uint32_t)((y1 - y0) * (xe - xs)));
+    }
+}
+
+void EdgeFilter::processYuyv(const uint8_t* yuyv, int w, int h, int srcStride,
+                             uint8_t* dst, int dstStride)
+{
+    processYuyv(yuyv, w, h, srcStride, dst, dstStride, w, h);
+}
+
+void EdgeFilter::processYuyv(const uint8_t* yuyv, int srcW, int srcH, int srcStride,
+                             uint8_t* dst, int dstStride, int outW, int outH)
+{
+    const int w = (outW <= 0 || outW > srcW) ? srcW : outW;
+    const int h = (outH <= 0 || outH > srcH) ? srcH : outH;
+
+    if (w < 3 || h < 3) {
+        for (int y = 0; y < h; ++y) std::memset(dst + y * dstStride, 0, w);
+        return;
+    }
+
+    m_src = yuyv;
+    m_srcStride = srcStride;
+    if (srcW != m_srcW || srcH != m_srcH || w != m_outW || h != m_outH) {
+        m_srcW = srcW;
+        m_srcH = srcH;
+        m_outW = w;
+        m_outH = h;
+        m_acc.assign(srcW, 0);
+        m_xSpan.resize(w + 1);
+        for (int x = 0; x <= w; ++x) m_xSpan[x] = x * srcW / w;
+    }
+
+    if (w != m_w) {
+        m_w = w;
+        m_y.assign(3 * w, 0);
+        m_mag.assign(3 * w, 0);
+        m_dir.assign(3 * w, 0);
+    }
+
+    auto yRow   = [&](int r) { return &m_y[(r % 3) * w]; };
+    auto magRowP = [&](int r) { return &m_mag[(r % 3) * w]; };
+    auto dirRowP = [&](int r) { return &m_dir[(r % 3) * w]; };
+
+    fetchRow(0, yRow(0));
+    fetchRow(1, yRow(1));
+    std::memset(dst, 0, w);
+
+    if (!m_thin) {
+        for (int y = 1; y < h - 1; ++y) {
+            fetchRow(y + 1, yRow(y + 1));
+            sobelRow(yRow(y - 1), yRow(y), yRow(y + 1), dst + y * dstStride, w);
+        }
+    } else {
+        // suppression for row y-1 needs magnitudes of y-2..y, so it lags one row
+        std::fill(magRowP(0), magRowP(0) + w, 0);
+        for (int y = 1; y < h - 1; ++y) {
+            fetchRow(y + 1, yRow(y + 1));
+            magRow(yRow(y - 1), yRow(y), yRow(y + 1), magRowP(y), dirRowP(y), w);
+            if (y >= 2)
+                suppressRow(magRowP(y - 2), magRowP(y - 1), magRowP(y), dirRowP(y - 1),
+                            dst + (y - 1) * dstStride, w);
+        }
+        std::fill(magRowP(h - 1), magRowP(h - 1) + w, 0);
+        suppressRow(magRowP(h - 3), magRowP(h - 2), magRowP(h - 1), dirRowP(h - 2),
+                    dst + (h - 2) * dstStride, w);
+    }
+
+    std::memset(dst + (h - 1) * dstStride, 0, w);
+}
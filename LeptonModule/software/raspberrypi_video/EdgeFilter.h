@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Row-streaming 3x3 Sobel edge detector that reads the Y samples of a packed
+// YUYV frame directly, so the camera layer never goes through RGB when emboss
+// is enabled. Output is Grayscale8: 255 on edges, 0 elsewhere.
+class EdgeFilter {
+public:
+    // Threshold is in the same units as the old per-paint emboss:
+    // (|gx| + |gy|) / 8, useful range ~10..80.
+    void setThreshold(int thr);
+    // Thin (Canny-style) edges: keep only local maxima along the gradient.
+    void setThin(bool thin);
+
+    void processYuyv(const uint8_t* yuyv, int w, int h, int srcStride,
+                     uint8_t* dst, int dstStride);
+
+    // Same, but the Y plane is box-downsampled to outW x outH (<= w x h)
+    // while it is streamed in, so detection runs at the working resolution.
+    void processYuyv(const uint8_t* yuyv, int w, int h, int srcStride,
+                     uint8_t* dst, int dstStride, int outW, int outH);
+
+private:
+    void fetchRow(int r, uint8_t* y);
+    void sobelRow(const uint8_t* p0, const uint8_t* p1, const uint8_t* p2,
+                  uint8_t* d, int w) const;
+    void magRow(const uint8_t* p0, const uint8_t* p1, const uint8_t* p2,
+                uint16_t* mag, uint8_t* dir, int w) const;
+    void suppressRow(const uint16_t* m0, const uint16_t* m1, const uint16_t* m2,
+                     const uint8_t* dir, uint8_t* d, int w) const;
+
+    int m_thr8 = 35 * 8;
+    bool m_thin = false;
+
+    // current frame geometry, set by processYuyv
+    const uint8_t* m_src = nullptr;
+    int m_srcW = 0, m_srcH = 0, m_srcStride = 0;
+    int m_outW = 0, m_outH = 0;
+    std::vector<int> m_xSpan;     // outW + 1 source column boundaries
+    std::vector<uint32_t> m_acc;  // per source column sums for one output row
+
+    int m_w = 0;
+    std::vector<uint8_t> m_y;     // 3 Y rows (ring)
+    std::vector<uint16_t> m_mag;  // 3 magnitude rows (ring, thin mode)
+    std::vector<uint8_t> m_dir;   // 3 direction rows (ring, thin mode)
+};
@@ -0,0 +1,145 @@
+#include "FbOutput.h"
+
+#include <QDebug>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cstring>
+
+#ifndef FBIO_WAITFORVSYNC
+#define FBIO_WAITFORVSYNC _IOW('F', 0x20, __u32)
+#endif
+
+FbOutput::~FbOutput()
+{
+    close();
+}
+
+bool FbOutput::open(const QString& path, bool fake, int fakeW, int fakeH, int fakeBpp)
+{
+    close();
+
+    QByteArray p = path.toUtf8();
+    m_fake = fake;
+    if (!m_fake) {
+        // never create files under /dev for a mistyped device name
+        struct stat st;
+        if (::stat(p.constData(), &st) != 0 || !S_ISCHR(st.st_mode)) {
+            qDebug() << "FbOutput: not a framebuffer device" << path;
+            return false;
+        }
+    }
+
+    m_fd = ::open(p.constData(), m_fake ? (O_RDWR | O_CREAT) : O_RDWR, 0644);
+    if (m_fd < 0) {
+        qDebug() << "FbOutput: open failed" << path;
+        return false;
+    }
+
+    int bpp;
+    if (m_fake) {
+        m_w = fakeW;
+        m_h = fakeH;
+        bpp = (fakeBpp == 32) ? 32 : 16;
+        m_stride = m_w * bpp / 8;
+        m_pageCount = 1;
+        m_mapLen = (size_t)m_stride * m_h;
+        if (ftruncate(m_fd, (off_t)m_mapLen) < 0) {
+            close();
+            return false;
+        }
+        std::memset(&m_var, 0, sizeof(m_var));
+        m_var.bits_per_pixel = bpp;
+        m_var.red.offset = (bpp == 32) ? 16 : 11;
+    } else {
+        fb_fix_screeninfo fix;
+        if (ioctl(m_fd, FBIOGET_FSCREENINFO, &fix) < 0 ||
+            ioctl(m_fd, FBIOGET_VSCREENINFO, &m_var) < 0) {
+            close();
+            return false;
+        }
+
+        // ask for a second page below the visible one for page flipping
+        if (m_var.yres_virtual < 2 * m_var.yres) {
+            fb_var_screeninfo v = m_var;
+            v.yres_virtual = 2 * m_var.yres;
+            v.yoffset = 0;
+            if (ioctl(m_fd, FBIOPUT_VSCREENINFO, &v) == 0) {
+                ioctl(m_fd, FBIOGET_VSCREENINFO, &m_var);
+                ioctl(m_fd, FBIOGET_FSCREENINFO, &fix);
+            }
+        }
+
+        m_w = m_var.xres;
+        m_h = m_var.yres;
+        bpp = m_var.bits_per_pixel;
+        m_stride = fix.line_length;
+        m_pageCount = (m_var.yres_virtual >= 2 * m_var.yres && fix.ypanstep > 0) ? 2 : 1;
+        m_mapLen = fix.smem_len;
+    }
+
+    if (bpp == 16) {
+        m_format = QImage::Format_RGB16;
+    } else if (bpp == 32) {
+        // XRGB8888 in memory is what Qt calls RGB32; red in the low byte is RGBX8888
+        m_format = (m_var.red.offset == 16) ? QImage::Format_RGB32 : QImage::Format_RGBX8888;
+    } else {
+        qDebug() << "FbOutput: unsupported depth" << bpp;
+        close();
+        return false;
+    }
+
+    void* map = mmap(nullptr, m_mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED) {
+        close();
+        return false;
+    }
+    m_map = (uchar*)map;
+
+    for (int i = 0; i < m_pageCount; i++)
+        m_pages[i] = QImage(m_map + (size_t)i * m_h * m_stride, m_w, m_h, m_stride, m_format);
+
+    m_back = (m_pageCount == 2 && m_var.yoffset == 0) ? 1 : 0;
+
+    qDebug() << "FbOutput:" << path << m_w << "x" << m_h << bpp << "bpp"
+             << m_pageCount << "page(s)" << (m_fake ? "(fake)" : "");
+    return true;
+}
+
+void FbOutput::close()
+{
+    for (auto& pg : m_pages) pg = QImage();
+
+    if (m_map) {
+        if (!m_fake && m_pageCount == 2 && m_var.yoffset != 0) {
+            m_var.yoffset = 0;
+            ioctl(m_fd, FBIOPAN_DISPLAY, &m_var);
+        }
+        munmap(m_map, m_mapLen);
+        m_map = nullptr;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool FbOutput::flip()
+{
+    if (!m_map || m_fake || m_pageCount < 2) return false;
+
+    m_var.yoffset = m_back * m_h;
+    ioctl(m_fd, FBIOPAN_DISPLAY, &m_var);
+
+    // don't touch the old front page until it is really off screen
+    if (m_vsync) {
+        __u32 crtc = 0;
+        if (ioctl(m_fd, FBIO_WAITFORVSYNC, &crtc) < 0) m_vsync = false;
+    }
+    m_back ^= 1;
+    return m_vsync;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <QImage>
+#include <QString>
+#include <linux/fb.h>
+
+// Direct /dev/fbN output for headless kiosks. Each page of the mapped
+// framebuffer is exposed as a QImage in the display's native format (RGB565
+// or XRGB8888), so the compositor paints straight into scanout memory and
+// flips pages with FBIOPAN_DISPLAY, skipping the QWidget/backing store blit.
+//
+// With fake set, a regular file stands in for the device (fake framebuffer):
+// it is created if needed, sized to one WxH page at the requested depth and
+// rewritten in place every frame, e.g. view with:
+//   ffmpeg -f rawvideo -pix_fmt rgb565le -s 640x480 -i <file>
+// Without it the path must be a framebuffer character device.
+class FbOutput {
+public:
+    FbOutput() = default;
+    ~FbOutput();
+
+    bool open(const QString& path, bool fake = false, int fakeW = 640, int fakeH = 480, int fakeBpp = 16);
+    void close();
+
+    bool isOpen() const { return m_map != nullptr; }
+    bool isFake() const { return m_fake; }
+    QSize size() const { return QSize(m_w, m_h); }
+    QImage::Format format() const { return m_format; }
+
+    // page that is not on screen; paint into it, then flip()
+    QImage& backBuffer() { return m_pages[m_back]; }
+    // returns true when the flip waited for vblank
+    bool flip();
+
+private:
+    int m_fd = -1;
+    uchar* m_map = nullptr;
+    size_t m_mapLen = 0;
+    bool m_fake = false;
+    bool m_vsync = true;
+
+    int m_w = 0;
+    int m_h = 0;
+    int m_stride = 0;
+    QImage::Format m_format = QImage::Format_RGB16;
+    fb_var_screeninfo m_var {};
+
+    QImage m_pages[2];
+    int m_pageCount = 1;
+    int m_back = 0;
+};
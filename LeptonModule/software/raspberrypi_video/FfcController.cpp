@@ -0,0 +1,221 @@
+#include "FfcController.h"
+#include "CciWorker.h"
+#include "LeptonThread.h"
+
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <cmath>
+#include <memory>
+
+// every Nth pixel feeds the activity estimate
+static const int s_activityStride = 4;
+// without frames for this long the scene counts as quiet (e.g. RGB888 video)
+static const qint64 s_activityStaleMs = 2000;
+
+FfcController::FfcController(CciWorker* cci, QObject* parent)
+    : QObject(parent), m_cci(cci)
+{
+    m_clock.start();
+    connect(&m_timer, &QTimer::timeout, this, &FfcController::onTick);
+    connect(m_cci, &CciWorker::finished, this, &FfcController::onCciFinished);
+    m_timer.start(1000);
+}
+
+void FfcController::setConfig(const FfcCfg& cfg)
+{
+    bool modeChanged = (cfg.mode != m_cfg.mode || cfg.period_s != m_cfg.period_s
+                        || cfg.temp_delta != m_cfg.temp_delta);
+    // main passes the FFC section on every config change; only a change to
+    // it restarts the max_defer_s clock of a due FFC
+    bool changed = modeChanged || cfg.max_defer_s != m_cfg.max_defer_s
+                   || cfg.quiet != m_cfg.quiet;
+    if (!changed && m_modeApplied) return;
+    {
+        QMutexLocker lk(&m_mtx);
+        m_cfg = cfg;
+        m_dueSinceMs = -1;
+    }
+    if (modeChanged || !m_modeApplied) {
+        m_modeApplied = true;
+        applyMode();
+    }
+}
+
+void FfcController::applyMode()
+{
+    // the camera's schedule only runs FFC itself in auto mode, but its
+    // ffcDesired flag follows the same period and delta in every mode
+    bool automatic = (m_cfg.mode == "auto");
+    unsigned int periodMs = (unsigned int)m_cfg.period_s * 1000;
+    unsigned int deltaCk = (unsigned int)std::lround(m_cfg.temp_delta * 100);
+    m_cci->submit("ffc_mode", [automatic, periodMs, deltaCk]() {
+        return lepton_set_ffc_mode(automatic, periodMs, deltaCk);
+    }, 2000, [](const CciWorker::Result& r) {
+        if (!r.ok) qDebug() << "FfcController: setting the shutter mode failed:" << r.status;
+    });
+}
+
+void FfcController::onCciFinished(QString op, int status, bool ok, bool timedOut)
+{
+    Q_UNUSED(status);
+    Q_UNUSED(timedOut);
+    // a reboot puts the camera back on its own schedule
+    if (op == "reboot" && ok) applyMode();
+}
+
+void FfcController::onRawFrame(const RawFrame& frame)
+{
+    if (frame.isNull() || frame.frozen) return;
+
+    const int n = frame.px.size() / s_activityStride;
+    const quint16* px = frame.px.constData();
+    if (m_prev.size() != n) {
+        m_prev.resize(n);
+        for (int i = 0; i < n; ++i) m_prev[i] = px[i * s_activityStride];
+        m_activity = -1.0;
+        m_lastFrameMs = m_clock.elapsed();
+        return;
+    }
+
+    quint16 lo = 65535, hi = 0;
+    quint64 diff = 0;
+    for (int i = 0; i < n; ++i) {
+        quint16 v = px[i * s_activityStride];
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+        diff += (v > m_prev[i]) ? v - m_prev[i] : m_prev[i] - v;
+        m_prev[i] = v;
+    }
+    double a = (hi > lo && n > 0) ? (double)diff / n / (hi - lo) : 0.0;
+
+    QMutexLocker lk(&m_mtx);
+    m_activity = (m_activity < 0) ? a : 0.7 * m_activity + 0.3 * a;
+    m_lastFrameMs = m_clock.elapsed();
+}
+
+bool FfcController::sceneQuiet() const
+{
+    if (m_activity < 0 || m_clock.elapsed() - m_lastFrameMs > s_activityStaleMs) return true;
+    return m_activity < m_cfg.quiet;
+}
+
+void FfcController::onTick()
+{
+    if (m_querying || m_running) return;
+    m_querying = true;
+
+    // the callback fires on the worker (or watchdog) thread; a timed-out
+    // read may still be filling st, so it is only used when the call returned
+    auto st = std::make_shared<LeptonFfcState>();
+    m_cci->submit("ffc_state", [st]() { return lepton_get_ffc_state(st.get()); }, 1000,
+                  [this, st](const CciWorker::Result& r) {
+        LeptonFfcState copy = {};
+        if (r.ok) copy = *st;
+        QMetaObject::invokeMethod(this, [this, r, copy]() { onState(r.ok, copy); },
+                                  Qt::QueuedConnection);
+    });
+}
+
+void FfcController::onState(bool ok, const LeptonFfcState& st)
+{
+    m_querying = false;
+    QMutexLocker lk(&m_mtx);
+    if (!ok) {
+        m_stateErrors++;
+        return;
+    }
+    m_fpaK = st.fpaKelvin;
+    m_msSinceFfc = st.msSinceFfc;
+    m_camDesired = st.desired;
+    if (m_fpaAtFfcK < 0) m_fpaAtFfcK = st.fpaKelvin;
+
+    if (m_cfg.mode == "auto") {
+        // the camera picks the time; keep the frozen frames out of the
+        // statistics as far as a 1 s poll can see them
+        bool busy = (st.status == 1);
+        if (busy != m_cameraFfc) {
+            m_cameraFfc = busy;
+            if (busy) m_cameraFfcs++;
+            else m_fpaAtFfcK = -1.0;
+            lk.unlock();
+            setFrozen(busy);
+        }
+        return;
+    }
+    if (m_cfg.mode != "scheduled") return;
+
+    QString reason;
+    if (st.msSinceFfc >= (quint32)m_cfg.period_s * 1000) reason = "period";
+    else if (std::fabs(st.fpaKelvin - m_fpaAtFfcK) >= m_cfg.temp_delta) reason = "temp";
+    else if (st.desired) reason = "camera";
+    if (reason.isEmpty()) {
+        m_dueSinceMs = -1;
+        return;
+    }
+
+    qint64 now = m_clock.elapsed();
+    if (m_dueSinceMs < 0) m_dueSinceMs = now;
+    m_dueReason = reason;
+    bool quiet = sceneQuiet();
+    if (!quiet && now - m_dueSinceMs < (qint64)m_cfg.max_defer_s * 1000) return;
+
+    if (!quiet) m_deferredFfcs++;
+    lk.unlock();
+    runFfc(reason);
+}
+
+void FfcController::requestFfc()
+{
+    if (m_running) return;
+    runFfc("request");
+}
+
+void FfcController::runFfc(const QString& reason)
+{
+    m_running = true;
+    {
+        QMutexLocker lk(&m_mtx);
+        m_dueSinceMs = -1;
+        m_lastReason = reason;
+    }
+    setFrozen(true);
+    m_cci->ffc([this](const CciWorker::Result& r) {
+        QMetaObject::invokeMethod(this, [this, r]() {
+            m_running = false;
+            setFrozen(false);
+            QMutexLocker lk(&m_mtx);
+            if (r.ok) m_ffcs++;
+            else m_failed++;
+            m_lastFfcMs = r.ms;
+            m_fpaAtFfcK = -1.0;
+        }, Qt::QueuedConnection);
+    });
+}
+
+void FfcController::setFrozen(bool on)
+{
+    if (m_thread) m_thread->setFfcFreeze(on);
+}
+
+QJsonObject FfcController::statsJson() const
+{
+    QMutexLocker lk(&m_mtx);
+    QJsonObject o;
+    o["mode"] = m_cfg.mode;
+    o["ffcs"] = (double)m_ffcs;
+    o["deferred_ffcs"] = (double)m_deferredFfcs;
+    o["camera_ffcs"] = (double)m_cameraFfcs;
+    o["failed"] = (double)m_failed;
+    o["state_errors"] = (double)m_stateErrors;
+    o["last_reason"] = m_lastReason;
+    o["last_ffc_ms"] = (double)m_lastFfcMs;
+    o["since_ffc_s"] = m_msSinceFfc / 1000.0;
+    o["fpa_k"] = m_fpaK;
+    o["fpa_drift_k"] = (m_fpaAtFfcK < 0) ? 0.0 : m_fpaK - m_fpaAtFfcK;
+    o["camera_desired"] = m_camDesired;
+    o["due"] = (m_dueSinceMs < 0) ? QString() : m_dueReason;
+    o["due_for_s"] = (m_dueSinceMs < 0) ? 0.0 : (m_clock.elapsed() - m_dueSinceMs) / 1000.0;
+    o["activity"] = m_activity;
+    return o;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <QJsonObject>
+
+#include "Config.h"
+#include "RawFrame.h"
+#include "Lepton_I2C.h"
+
+class CciWorker;
+class LeptonThread;
+
+// Decides when the Lepton runs its flat field correction, which freezes
+// the video for a few hundred ms. In "scheduled" mode the camera's own
+// schedule is switched off; once an FFC is due (period, FPA temperature
+// drift, or the camera's ffcDesired flag) it is held back until the scene
+// is quiet, or until max_defer_s has passed. The capture thread is told to
+// keep frozen and settling frames out of its statistics.
+//
+// Lives on the GUI thread; camera state is polled once a second through
+// the CCI worker.
+class FfcController : public QObject {
+    Q_OBJECT
+public:
+    explicit FfcController(CciWorker* cci, QObject* parent = nullptr);
+
+    void setCapture(LeptonThread* thread) { m_thread = thread; }
+    void setConfig(const FfcCfg& cfg);
+
+    // any thread
+    QJsonObject statsJson() const;
+
+public slots:
+    // runs an FFC now, whatever the mode
+    void requestFfc();
+    // scene activity, from LeptonThread::updateRaw
+    void onRawFrame(const RawFrame& frame);
+
+private slots:
+    void onTick();
+    void onCciFinished(QString op, int status, bool ok, bool timedOut);
+
+private:
+    void applyMode();
+    void onState(bool ok, const LeptonFfcState& st);
+    void runFfc(const QString& reason);
+    void setFrozen(bool on);
+    bool sceneQuiet() const;
+
+    CciWorker* m_cci;
+    LeptonThread* m_thread = nullptr;
+    FfcCfg m_cfg;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    bool m_modeApplied = false;
+    bool m_querying = false;
+    bool m_running = false;
+    bool m_cameraFfc = false;   // auto mode: the camera reported an FFC in progress
+
+    // scene activity: mean frame-to-frame change over a pixel subsample,
+    // relative to the frame's range, smoothed
+    QVector<quint16> m_prev;
+    qint64 m_lastFrameMs = -1;
+
+    mutable QMutex m_mtx;       // everything below, for statsJson()
+    double m_activity = -1.0;   // < 0: unknown
+    double m_fpaK = 0.0;
+    double m_fpaAtFfcK = -1.0;  // < 0: take the next reading
+    quint32 m_msSinceFfc = 0;
+    bool m_camDesired = false;
+    qint64 m_dueSinceMs = -1;
+    QString m_dueReason;
+    quint64 m_ffcs = 0;
+    quint64 m_deferredFfcs = 0; // ran at max_defer_s without a quiet scene
+    quint64 m_cameraFfcs = 0;   // started by the camera itself
+    quint64 m_failed = 0;
+    quint64 m_stateErrors = 0;
+    QString m_lastReason;
+    qint64 m_lastFfcMs = 0;     // duration of the last requested FFC
+};
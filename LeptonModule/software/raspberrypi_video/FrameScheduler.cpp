@@ -0,0 +1,102 @@
+#include "FrameScheduler.h"
+
+#include <QJsonArray>
+#include <QMutexLocker>
+
+// upper bucket edges in ms; the last bucket is open ended
+static const int s_edgesMs[] = { 2, 4, 8, 16, 33, 50, 100 };
+
+FrameScheduler::FrameScheduler(QObject* parent) : QObject(parent)
+{
+    m_clock.start();
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &FrameScheduler::onTick);
+    setTargetFps(m_fps);
+}
+
+void FrameScheduler::setTargetFps(int fps)
+{
+    fps = qBound(1, fps, 120);
+    // called on every config change; restarting would delay the next frame
+    if (fps == m_fps && m_timer.isActive()) return;
+    m_fps = fps;
+    m_timer.start(1000 / fps);
+}
+
+void FrameScheduler::markDirty()
+{
+    m_dirty = true;
+    QMutexLocker lk(&m_statsMtx);
+    m_updates++;
+}
+
+void FrameScheduler::onTick()
+{
+    if (!m_dirty) {
+        QMutexLocker lk(&m_statsMtx);
+        m_idleTicks++;
+        return;
+    }
+    m_dirty = false;
+    emit frameDue();
+}
+
+int FrameScheduler::bucketFor(qint64 ns)
+{
+    qint64 ms = ns / 1000000;
+    for (int i = 0; i < Buckets - 1; i++)
+        if (ms < s_edgesMs[i]) return i;
+    return Buckets - 1;
+}
+
+void FrameScheduler::frameRendered(qint64 renderNs, bool vsynced)
+{
+    qint64 now = m_clock.nsecsElapsed();
+    {
+        QMutexLocker lk(&m_statsMtx);
+        m_frames++;
+        m_renderHist[bucketFor(renderNs)]++;
+        if (m_lastFrameNs >= 0)
+            m_intervalHist[bucketFor(now - m_lastFrameNs)]++;
+        m_lastFrameNs = now;
+
+        m_windowFrames++;
+        qint64 span = now - m_windowStartNs;
+        if (span >= 1000000000LL) {
+            m_achievedFps = m_windowFrames * 1e9 / span;
+            m_windowStartNs = now;
+            m_windowFrames = 0;
+        }
+    }
+
+    // lock the next deadline to this vblank
+    if (vsynced) m_timer.start(1000 / m_fps);
+}
+
+QJsonObject FrameScheduler::statsJson() const
+{
+    QMutexLocker lk(&m_statsMtx);
+
+    QJsonArray edges;
+    for (int e : s_edgesMs) edges.append(e);
+
+    QJsonArray render, interval;
+    for (int i = 0; i < Buckets; i++) {
+        render.append((double)m_renderHist[i]);
+        interval.append((double)m_intervalHist[i]);
+    }
+
+    QJsonObject o;
+    o["target_fps"] = m_fps.load();
+    // a stalled pipeline should read as 0, not as the last good window
+    bool stale = m_lastFrameNs < 0 || m_clock.nsecsElapsed() - m_lastFrameNs > 2000000000LL;
+    o["achieved_fps"] = stale ? 0.0 : m_achievedFps;
+    o["source_updates"] = (double)m_updates;
+    o["frames"] = (double)m_frames;
+    o["coalesced_updates"] = (double)(m_updates > m_frames ? m_updates - m_frames : 0);
+    o["idle_ticks"] = (double)m_idleTicks;
+    o["hist_edges_ms"] = edges;
+    o["render_ms_hist"] = render;
+    o["interval_ms_hist"] = interval;
+    return o;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QJsonObject>
+
+#include <atomic>
+
+// Coalesces source updates (thermal, camera, config) into display frames at a
+// fixed target rate. Sources only mark the scene dirty; a precise timer emits
+// frameDue() at most once per period, so the widget repaints at the display
+// rate instead of the sum of the source rates, and updates that arrive while
+// a frame is pending are merged (the latest image wins).
+//
+// When the output reports a vsync-locked present (fb page flip), the timer is
+// re-phased from that point so rendering starts right after each vblank.
+class FrameScheduler : public QObject {
+    Q_OBJECT
+public:
+    explicit FrameScheduler(QObject* parent = nullptr);
+
+    void setTargetFps(int fps);
+    int targetFps() const { return m_fps; }
+
+    void markDirty();
+    // renderNs: time spent compositing; vsynced: present waited for vblank
+    void frameRendered(qint64 renderNs, bool vsynced);
+
+    QJsonObject statsJson() const;
+
+signals:
+    void frameDue();
+
+private slots:
+    void onTick();
+
+private:
+    enum { Buckets = 8 };
+    static int bucketFor(qint64 ns);
+
+    QTimer m_timer;
+    std::atomic<int> m_fps{30};  // also read by statsJson()
+    bool m_dirty = false;
+
+    mutable QMutex m_statsMtx;
+    QElapsedTimer m_clock;
+    qint64 m_lastFrameNs = -1;
+    quint64 m_updates = 0;     // markDirty() calls
+    quint64 m_frames = 0;      // frames actually rendered
+    quint64 m_idleTicks = 0;   // ticks with nothing new to show
+    qint64 m_windowStartNs = 0;
+    int m_windowFrames = 0;
+    double m_achievedFps = 0.0;  // frames over the last ~1 s window
+    quint64 m_renderHist[Buckets] = {};
+    quint64 m_intervalHist[Buckets] = {};
+};
@@ -0,0 +1,80 @@
+#include "HttpParser.h"
+
+QByteArray HttpRequest::header(const QByteArray& lowerName) const
+{
+    for (const auto& h : headers)
+        if (h.first == lowerName) return h.second;
+    return QByteArray();
+}
+
+bool HttpRequest::keepAlive() const
+{
+    QByteArray c = header("connection").toLower();
+    if (version == "HTTP/1.0") return c.contains("keep-alive");
+    return !c.contains("close");
+}
+
+HttpParser::Status HttpParser::next(HttpRequest* req)
+{
+    if (m_errorStatus) return Error;
+
+    // tolerate stray CRLFs between pipelined requests (RFC 7230 3.5)
+    int skip = 0;
+    while (skip + 1 < m_buf.size() && m_buf[skip] == '\r' && m_buf[skip + 1] == '\n') skip += 2;
+    if (skip) m_buf.remove(0, skip);
+
+    int end = m_buf.indexOf("\r\n\r\n");
+    if (end < 0) {
+        if (m_buf.size() > MaxHeaderBytes) return fail(431);
+        return NeedMore;
+    }
+    if (end > MaxHeaderBytes) return fail(431);
+
+    HttpRequest r;
+    int eol = m_buf.indexOf("\r\n");
+    QList<QByteArray> first = m_buf.left(eol).split(' ');
+    if (first.size() != 3 || first[0].isEmpty() || !first[1].startsWith('/')
+            || !first[2].startsWith("HTTP/1."))
+        return fail(400);
+    r.method = first[0];
+    r.url = first[1];
+    r.version = first[2];
+    int q = r.url.indexOf('?');
+    r.path = q >= 0 ? r.url.left(q) : r.url;
+
+    int pos = eol + 2;
+    while (pos < end) {
+        int le = m_buf.indexOf("\r\n", pos);
+        QByteArray line = m_buf.mid(pos, le - pos);
+        pos = le + 2;
+        int c = line.indexOf(':');
+        if (c <= 0) return fail(400);
+        r.headers.append(qMakePair(line.left(c).trimmed().toLower(), line.mid(c + 1).trimmed()));
+    }
+
+    if (!r.header("transfer-encoding").isEmpty()) return fail(501);
+
+    qint64 len = 0;
+    QByteArray cl = r.header("content-length");
+    if (!cl.isEmpty()) {
+        bool ok = false;
+        len = cl.toLongLong(&ok);
+        if (!ok || len < 0) return fail(400);
+        if (len > MaxBodyBytes) return fail(413);
+    }
+
+    int total = end + 4 + (int)len;
+    if (m_buf.size() < total) return NeedMore;
+
+    r.body = m_buf.mid(end + 4, (int)len);
+    m_buf.remove(0, total);
+    *req = r;
+    return Ready;
+}
+
+QByteArray HttpParser::takeRemaining()
+{
+    QByteArray rest = m_buf;
+    m_buf.clear();
+    return rest;
+}
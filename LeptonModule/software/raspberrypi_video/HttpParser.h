@@ -0,0 +1,43 @@
+#pragma once
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+
+struct HttpRequest {
+    QByteArray method;
+    QByteArray url;       // as sent, including ?query
+    QByteArray path;      // url without the query
+    QByteArray version;   // "HTTP/1.1"
+    QList<QPair<QByteArray, QByteArray>> headers; // names lower-cased
+    QByteArray body;
+
+    QByteArray header(const QByteArray& lowerName) const;
+    // HTTP/1.1 defaults to keep-alive, HTTP/1.0 only with "Connection: keep-alive"
+    bool keepAlive() const;
+};
+
+// Incremental HTTP/1.1 request parser. Bytes are fed as they arrive; next()
+// pops complete requests in order, so pipelined requests in one read and
+// requests split over several reads both work. Chunked request bodies are
+// not accepted (nothing here needs them).
+class HttpParser {
+public:
+    enum Status { NeedMore, Ready, Error };
+
+    void feed(const QByteArray& data) { m_buf += data; }
+    Status next(HttpRequest* req);
+
+    // HTTP status to answer with after Error (400, 413, 431, 501)
+    int errorStatus() const { return m_errorStatus; }
+    // bytes received after the last request, e.g. behind a WebSocket upgrade
+    QByteArray takeRemaining();
+
+    static const int MaxHeaderBytes = 16 * 1024;
+    static const int MaxBodyBytes = 1024 * 1024;
+
+private:
+    Status fail(int status) { m_errorStatus = status; return Error; }
+
+    QByteArray m_buf;
+    int m_errorStatus = 0;
+};
@@ -0,0 +1,235 @@
+#include "JpegEncoder.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+#include <cstdio>
+#include <cstring>
+#include <csetjmp>
+#include <vector>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+// libjpeg's default error handler calls exit(); jump back out instead
+struct JpegErr {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+static void jpegErrorExit(j_common_ptr cinfo)
+{
+    JpegErr* err = reinterpret_cast<JpegErr*>(cinfo->err);
+    longjmp(err->jump, 1);
+}
+
+// destination manager that writes into a QByteArray, growing as needed
+struct JpegDest {
+    jpeg_destination_mgr pub;
+    QByteArray* out;
+};
+
+static void destInit(j_compress_ptr cinfo)
+{
+    JpegDest* d = reinterpret_cast<JpegDest*>(cinfo->dest);
+    if (d->out->size() < 64 * 1024) d->out->resize(64 * 1024);
+    d->pub.next_output_byte = reinterpret_cast<JOCTET*>(d->out->data());
+    d->pub.free_in_buffer = d->out->size();
+}
+
+static boolean destEmpty(j_compress_ptr cinfo)
+{
+    JpegDest* d = reinterpret_cast<JpegDest*>(cinfo->dest);
+    int used = d->out->size();
+    d->out->resize(used * 2);
+    d->pub.next_output_byte = reinterpret_cast<JOCTET*>(d->out->data()) + used;
+    d->pub.free_in_buffer = d->out->size() - used;
+    return TRUE;
+}
+
+static void destTerm(j_compress_ptr cinfo)
+{
+    JpegDest* d = reinterpret_cast<JpegDest*>(cinfo->dest);
+    d->out->resize(d->out->size() - (int)d->pub.free_in_buffer);
+}
+
+// RGB565 -> RGB888, replicating the high bits into the low ones
+static void rgb565Row(const quint16* src, JSAMPLE* dst, int w)
+{
+    for (int x = 0; x < w; ++x) {
+        quint16 p = src[x];
+        int r = (p >> 11) & 0x1f;
+        int g = (p >> 5) & 0x3f;
+        int b = p & 0x1f;
+        *dst++ = (JSAMPLE)((r << 3) | (r >> 2));
+        *dst++ = (JSAMPLE)((g << 2) | (g >> 4));
+        *dst++ = (JSAMPLE)((b << 3) | (b >> 2));
+    }
+}
+
+JpegEncoder::JpegEncoder(QObject* parent) : QThread(parent)
+{
+}
+
+JpegEncoder::~JpegEncoder()
+{
+    stop();
+    wait(1000);
+}
+
+void JpegEncoder::setParams(int quality, const QString& subsampling)
+{
+    QMutexLocker lk(&m_mtx);
+    m_quality = qBound(1, quality, 100);
+    if (subsampling == "444")      { m_hSamp = 1; m_vSamp = 1; }
+    else if (subsampling == "422") { m_hSamp = 2; m_vSamp = 1; }
+    else                           { m_hSamp = 2; m_vSamp = 2; }
+}
+
+void JpegEncoder::submit(const QImage& img, quint64 seq)
+{
+    QMutexLocker lk(&m_mtx);
+    if (m_hasPending) m_dropped++;
+    m_pending = img;
+    m_pendingSeq = seq;
+    m_hasPending = true;
+    m_cond.wakeOne();
+}
+
+void JpegEncoder::stop()
+{
+    QMutexLocker lk(&m_mtx);
+    m_stop = true;
+    m_cond.wakeOne();
+}
+
+quint64 JpegEncoder::encodedCount() const
+{
+    QMutexLocker lk(&m_mtx);
+    return m_encoded;
+}
+
+quint64 JpegEncoder::droppedCount() const
+{
+    QMutexLocker lk(&m_mtx);
+    return m_dropped;
+}
+
+double JpegEncoder::lastEncodeMs() const
+{
+    QMutexLocker lk(&m_mtx);
+    return m_lastMs;
+}
+
+void JpegEncoder::run()
+{
+    jpeg_compress_struct cinfo;
+    JpegErr jerr;
+    JpegDest dest;
+    QByteArray out;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    jpeg_create_compress(&cinfo);
+
+    dest.pub.init_destination = destInit;
+    dest.pub.empty_output_buffer = destEmpty;
+    dest.pub.term_destination = destTerm;
+    dest.out = &out;
+    cinfo.dest = &dest.pub;
+
+    std::vector<JSAMPLE> row;
+
+    for (;;) {
+        QImage img;
+        quint64 seq;
+        int quality, hSamp, vSamp;
+        {
+            QMutexLocker lk(&m_mtx);
+            while (!m_hasPending && !m_stop) m_cond.wait(&m_mtx);
+            if (m_stop) break;
+            img = m_pending;
+            seq = m_pendingSeq;
+            m_pending = QImage();
+            m_hasPending = false;
+            quality = m_quality;
+            hSamp = m_hSamp;
+            vSamp = m_vSamp;
+        }
+        if (img.isNull()) continue;
+
+        QElapsedTimer t;
+        t.start();
+
+        // 32-bit and RGB888 rows go in as-is, RGB16 is expanded per row,
+        // anything else is converted once up front
+        J_COLOR_SPACE inSpace;
+        int inComponents;
+        switch (img.format()) {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+            inSpace = JCS_EXT_BGRX; inComponents = 4; break;
+        case QImage::Format_RGBX8888:
+        case QImage::Format_RGBA8888:
+            inSpace = JCS_EXT_RGBX; inComponents = 4; break;
+        case QImage::Format_RGB888:
+            inSpace = JCS_RGB; inComponents = 3; break;
+        case QImage::Format_Grayscale8:
+            inSpace = JCS_GRAYSCALE; inComponents = 1; break;
+        default:
+            inSpace = JCS_RGB; inComponents = 3; break;
+        }
+        if (inSpace == JCS_RGB && img.format() != QImage::Format_RGB16
+                && img.format() != QImage::Format_RGB888)
+            img = img.convertToFormat(QImage::Format_RGB888);
+        const bool perRow = (img.format() == QImage::Format_RGB16);
+        if (perRow) row.resize(img.width() * 3);
+
+        out.resize(out.capacity());
+
+        if (setjmp(jerr.jump)) {
+            jpeg_abort_compress(&cinfo);
+            emit encoded(QByteArray(), seq); // so waiters are not left hanging
+            continue;
+        }
+
+        cinfo.image_width = img.width();
+        cinfo.image_height = img.height();
+        cinfo.input_components = inComponents;
+        cinfo.in_color_space = inSpace;
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, quality, TRUE);
+        cinfo.dct_method = JDCT_IFAST;
+        if (inSpace != JCS_GRAYSCALE) {
+            cinfo.comp_info[0].h_samp_factor = hSamp;
+            cinfo.comp_info[0].v_samp_factor = vSamp;
+        }
+
+        jpeg_start_compress(&cinfo, TRUE);
+        while (cinfo.next_scanline < cinfo.image_height) {
+            const uchar* line = img.constScanLine(cinfo.next_scanline);
+            JSAMPROW rp;
+            if (perRow) {
+                rgb565Row(reinterpret_cast<const quint16*>(line), row.data(), img.width());
+                rp = row.data();
+            } else {
+                rp = const_cast<JSAMPROW>(line);
+            }
+            jpeg_write_scanlines(&cinfo, &rp, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+
+        // hand out a copy sized to the frame; out keeps its capacity for reuse
+        QByteArray jpeg(out.constData(), out.size());
+        {
+            QMutexLocker lk(&m_mtx);
+            m_encoded++;
+            m_lastMs = t.nsecsElapsed() / 1e6;
+        }
+        emit encoded(jpeg, seq);
+    }
+
+    jpeg_destroy_compress(&cinfo);
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <QThread>
+#include <QImage>
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+
+// MJPEG encoder worker. Frames are handed over through a one-slot mailbox
+// (a newer frame replaces one that has not been picked up yet) and
+// compressed with libjpeg-turbo directly, reusing one compressor for the
+// lifetime of the thread. Input is taken in the composite pixel format
+// (RGB32/RGBX8888 via the turbo BGRX/RGBX extensions, RGB16 row by row).
+class JpegEncoder : public QThread
+{
+    Q_OBJECT
+public:
+    explicit JpegEncoder(QObject* parent = nullptr);
+    ~JpegEncoder() override;
+
+    // quality 1..100, subsampling "420", "422" or "444"
+    void setParams(int quality, const QString& subsampling);
+
+    // latest frame wins; seq identifies the composite it came from
+    void submit(const QImage& img, quint64 seq);
+    void stop();
+
+    quint64 encodedCount() const;
+    quint64 droppedCount() const;
+    double lastEncodeMs() const;
+
+signals:
+    // jpeg is empty if libjpeg failed on this frame
+    void encoded(QByteArray jpeg, quint64 seq);
+
+protected:
+    void run() override;
+
+private:
+    mutable QMutex m_mtx;
+    QWaitCondition m_cond;
+    QImage m_pending;
+    quint64 m_pendingSeq = 0;
+    bool m_hasPending = false;
+    bool m_stop = false;
+
+    int m_quality = 70;
+    int m_hSamp = 2;
+    int m_vSamp = 2;
+
+    quint64 m_encoded = 0;
+    quint64 m_dropped = 0;
+    double m_lastMs = 0.0;
+};
@@ -1,16 +1,21 @@
 #include <iostream>
+#include <time.h>
 
 #include "LeptonThread.h"
 
 #include "Palettes.h"
 #include "SPI.h"
 #include "Lepton_I2C.h"
+#include "CciWorker.h"
+#include "PixelFormat.h"
 
 #define PACKET_SIZE 164
 #define PACKET_SIZE_UINT16 (PACKET_SIZE/2)
 #define PACKETS_PER_FRAME 60
 #define FRAME_SIZE_UINT16 (PACKET_SIZE_UINT16*PACKETS_PER_FRAME)
 #define FPS 27;
+// frames after an FFC that still carry its transient
+#define FFC_SETTLE_FRAMES 3
 
 LeptonThread::LeptonThread() : QThread()
 {
@@ -106,30 +111,46 @@ void LeptonThread::useRangeMaxValue(uint16_t newMaxValue)
 
 void LeptonThread::run()
 {
-	//create the initial image
-	myImage = QImage(myImageWidth, myImageHeight, QImage::Format_RGB16);
+	//create the initial image, already in the compositor's overlay format
+	myImage = QImage(myImageWidth, myImageHeight, PixelFormat::Overlay);
+	m_raw.width = myImageWidth;
+	m_raw.height = myImageHeight;
+	m_raw.px.resize(myImageWidth * myImageHeight);
+	m_toneIdx.resize(myImageWidth * myImageHeight);
 
 	const int *colormap = selectedColormap;
 	const int colormapSize = selectedColormapSize;
+	m_lutDirty = true;
 	uint16_t minValue = rangeMin;
 	uint16_t maxValue = rangeMax;
 	float diff = maxValue - minValue;
 	float scale = 255/diff;
 	uint16_t n_wrong_segment = 0;
 	uint16_t n_zero_value_drop_frame = 0;
+	int n_agc_fallback = 0;
+	bool rgb = false;
 
 	//open spi port
 	SpiOpenPort(0, spiSpeed);
 
 	while(true) {
 
+		if (rgb != m_cameraRgb) {
+			// packets change size with the format; idle past a few frame
+			// periods so VoSPI resynchronises on a packet boundary
+			rgb = m_cameraRgb;
+			log_message(3, std::string("VoSPI format ") + (rgb ? "RGB888" : "RAW14"));
+			usleep(200000);
+		}
+		int packetSize = rgb ? PACKET_SIZE_RGB888 : PACKET_SIZE;
+
 		//read data packets from lepton over SPI
 		int resets = 0;
 		int segmentNumber = -1;
 		for(int j=0;j<PACKETS_PER_FRAME;j++) {
 			//if it's a drop packet, reset j to 0, set to -1 so he'll be at 0 again loop
-			read(spi_cs0_fd, result+sizeof(uint8_t)*PACKET_SIZE*j, sizeof(uint8_t)*PACKET_SIZE);
-			int packetNumber = result[j*PACKET_SIZE+1];
+			read(spi_cs0_fd, result+sizeof(uint8_t)*packetSize*j, sizeof(uint8_t)*packetSize);
+			int packetNumber = result[j*packetSize+1];
 			if(packetNumber != j) {
 				j = -1;
 				resets += 1;
@@ -138,16 +159,28 @@ void LeptonThread::run()
 				//By polling faster, developers may easily exceed this count, and the down period between frames may then be flagged as a loss of sync
 				if(resets == 750) {
 					SpiClosePort(0);
-					lepton_reboot();
+					if (m_cci) {
+						// bounded by the worker's reboot timeout
+						m_cci->reboot().wait();
+					} else {
+						lepton_reboot();
+					}
 					n_wrong_segment = 0;
 					n_zero_value_drop_frame = 0;
 					usleep(750000);
 					SpiOpenPort(0, spiSpeed);
+					// a reboot restores the camera defaults, RAW14 and AGC off
+					m_cameraAgc = false;
+					m_cameraRgb = false;
+					rgb = false;
+					packetSize = PACKET_SIZE;
+					if (m_rgbWanted) applyVideoFormat();
+					else if (m_agcPolicy != 0) applyAgcPolicy();
 				}
 				continue;
 			}
 			if ((typeLepton == 3) && (packetNumber == 20)) {
-				segmentNumber = (result[j*PACKET_SIZE] >> 4) & 0x0f;
+				segmentNumber = (result[j*packetSize] >> 4) & 0x0f;
 				if ((segmentNumber < 1) || (4 < segmentNumber)) {
 					log_message(10, "[ERROR] Wrong segment number " + std::to_string(segmentNumber));
 					break;
@@ -176,18 +209,79 @@ void LeptonThread::run()
 			}
 
 			//
-			memcpy(shelf[segmentNumber - 1], result, sizeof(uint8_t) * PACKET_SIZE*PACKETS_PER_FRAME);
+			memcpy(shelf[segmentNumber - 1], result, sizeof(uint8_t) * packetSize*PACKETS_PER_FRAME);
 			if (segmentNumber != 4) {
 				continue;
 			}
 			iSegmentStop = 4;
 		}
 		else {
-			memcpy(shelf[0], result, sizeof(uint8_t) * PACKET_SIZE*PACKETS_PER_FRAME);
+			memcpy(shelf[0], result, sizeof(uint8_t) * packetSize*PACKETS_PER_FRAME);
 			iSegmentStop = 1;
 		}
 
-		if ((autoRangeMin == true) || (autoRangeMax == true)) {
+		if (m_lutDirty.exchange(false)) {
+			buildPaletteLut(colormap, colormapSize, m_lut);
+		}
+
+		if (rgb) {
+			// coloured on the camera: each packet is 80 RGB pixels, half a
+			// row on Lepton 3, a full row on Lepton 2
+			for(int iSegment = iSegmentStart; iSegment <= iSegmentStop; iSegment++) {
+				int ofsRow = 30 * (iSegment - 1);
+				for(int p = 0; p < PACKETS_PER_FRAME; p++) {
+					const uint8_t *src = shelf[iSegment - 1] + p * PACKET_SIZE_RGB888 + 4;
+					QRgb *dst;
+					if (typeLepton == 3) {
+						dst = reinterpret_cast<QRgb*>(myImage.scanLine(p / 2 + ofsRow)) + (p % 2) * (myImageWidth / 2);
+					}
+					else {
+						dst = reinterpret_cast<QRgb*>(myImage.scanLine(p));
+					}
+					for(int x = 0; x < 80; x++, src += 3) {
+						QRgb color = (src[0] << 16) | (src[1] << 8) | src[2];
+						// black is keyed out, as in the palette LUT
+						dst[x] = color ? (0xff000000 | color) : 0;
+					}
+				}
+			}
+			emit updateImage(myImage);
+			continue;
+		}
+
+		// with camera AGC the pixels already are palette indices
+		const bool cameraAgc = m_cameraAgc;
+		const int tone = cameraAgc ? -1 : (int)m_toneMode;
+
+		// during an FFC the camera repeats the last frame, keep the range
+		bool frozen = m_ffcFreeze;
+		if (!frozen && m_ffcSettle > 0) {
+			m_ffcSettle--;
+			frozen = true;
+		}
+
+		// the auto range for this frame comes from the frames before it, its
+		// statistics are collected by the unpack loop below
+		const bool trackRange = !cameraAgc && tone < 0 && !frozen && ((autoRangeMin == true) || (autoRangeMax == true));
+		if (cameraAgc || tone >= 0) {
+			m_range.reset();
+		}
+		if (trackRange) {
+			m_range.setClipPercent(m_rangeClip);
+			m_range.setSmoothing(m_rangeSmooth);
+			m_range.setHysteresis(m_rangeHyst);
+		}
+		if (trackRange && m_range.valid()) {
+			if (autoRangeMin == true) {
+				minValue = m_range.lo();
+			}
+			if (autoRangeMax == true) {
+				maxValue = m_range.hi();
+			}
+			diff = maxValue - minValue;
+			scale = 255/diff;
+		} else if (trackRange) {
+			// nothing to go on yet, scan this frame once
 			if (autoRangeMin == true) {
                                 minValue = 65535;
 			}
@@ -219,10 +313,22 @@ void LeptonThread::run()
 			scale = 255/diff;
 		}
 
+		if (trackRange) {
+			m_range.begin();
+		}
+		if (tone >= 0) {
+			m_tone.setMode((ToneMapper::Mode)tone);
+			m_tone.setPlateau(m_tonePlateau);
+			m_tone.setClipLimit(m_toneClip);
+			m_tone.begin();
+		}
+
 		int row, column;
-		uint16_t value;
 		uint16_t valueFrameBuffer;
-		QRgb color;
+		uint16_t highBits = 0;
+		bool dropped = false;
+		// detaches only if a consumer still holds the previous frame
+		quint16 *raw = m_raw.px.data();
 		for(int iSegment = iSegmentStart; iSegment <= iSegmentStop; iSegment++) {
 			int ofsRow = 30 * (iSegment - 1);
 			for(int i=0;i<FRAME_SIZE_UINT16;i++) {
@@ -230,39 +336,31 @@ void LeptonThread::run()
 				if(i % PACKET_SIZE_UINT16 < 2) {
 					continue;
 				}
+				int index;
 
 				//flip the MSB and LSB at the last second
 				valueFrameBuffer = (shelf[iSegment - 1][i*2] << 8) + shelf[iSegment - 1][i*2+1];
-				if (valueFrameBuffer == 0) {
+				if (cameraAgc) {
+					// 0 is a valid AGC output, and there is nothing to scale
+					highBits |= valueFrameBuffer;
+					index = valueFrameBuffer & 0xff;
+				} else if (valueFrameBuffer == 0) {
 					// Why this value is 0?
 					n_zero_value_drop_frame++;
 					if ((n_zero_value_drop_frame % 12) == 0) {
 						log_message(5, "[WARNING] Found zero-value. Drop the frame continuously " + std::to_string(n_zero_value_drop_frame) + " times");
 					}
+					dropped = true;
 					break;
+				} else if (tone >= 0) {
+					m_tone.add(valueFrameBuffer);
+					index = -1; // tone mapped below, once the whole frame is in
+				} else {
+					if (trackRange) m_range.add(valueFrameBuffer);
+					float scaled = (valueFrameBuffer - minValue) * scale;
+					index = !(scaled > 0) ? 0 : (scaled >= 256 ? 256 : (int)scaled); // NaN when max == min
 				}
 
-				//
-				value = (valueFrameBuffer - minValue) * scale;
-				int ofs_r = 3 * value + 0; if (colormapSize <= ofs_r) ofs_r = colormapSize - 1;
-				int ofs_g = 3 * value + 1; if (colormapSize <= ofs_g) ofs_g = colormapSize - 1;
-				int ofs_b = 3 * value + 2; if (colormapSize <= ofs_b) ofs_b = colormapSize - 1;
-				color = qRgb(colormap[ofs_r], colormap[ofs_g], colormap[ofs_b]);
-
-               // Make grayscale pixels black, keep colored pixels as-is
-               // background mode: if black -> make grayscale pixels black (for transparency keying)
-               // if grey -> keep grayscale as grayscale
-               bool blackBg = (m_backgroundMode == "black");
-               if (blackBg) {
-                   // If the colormap output is grayscale-ish (R==G==B), force it to black
-                   int r = qRed(color), g = qGreen(color), b = qBlue(color);
-                   if (r == g && g == b) {
-                       color = qRgb(0, 0, 0);
-                   }
-               } else {
-                   // leave 'color' unchanged (grey background stays grey)
-               }
-
 				if (typeLepton == 3) {
 					column = (i % PACKET_SIZE_UINT16) - 2 + (myImageWidth / 2) * ((i % (PACKET_SIZE_UINT16 * 2)) / PACKET_SIZE_UINT16);
 					row = i / PACKET_SIZE_UINT16 / 2 + ofsRow;
@@ -271,7 +369,41 @@ void LeptonThread::run()
 					column = (i % PACKET_SIZE_UINT16) - 2;
 					row = i / PACKET_SIZE_UINT16;
 				}
-				myImage.setPixel(column, row, color);
+				if (index >= 0) reinterpret_cast<QRgb*>(myImage.scanLine(row))[column] = m_lut[index];
+				raw[row * myImageWidth + column] = valueFrameBuffer;
+			}
+		}
+
+		if (dropped) {
+			// the rest of the shelf still holds the previous frame: keep the
+			// mix away from the range, the tone mapper, the display and
+			// everything fed by updateRaw
+			continue;
+		}
+
+		if (trackRange) {
+			m_range.end();
+		}
+
+		if (tone >= 0) {
+			m_tone.map(raw, myImageWidth, myImageHeight, m_toneIdx.data());
+			for(int row = 0; row < myImageHeight; row++) {
+				const uint8_t *src = &m_toneIdx[row * myImageWidth];
+				QRgb *dst = reinterpret_cast<QRgb*>(myImage.scanLine(row));
+				for(int column = 0; column < myImageWidth; column++) {
+					dst[column] = m_lut[src[column]];
+				}
+			}
+		}
+
+		if (cameraAgc && (highBits & 0xff00)) {
+			// 14-bit values: the camera is not (or no longer) in AGC mode
+			m_cameraAgc = false;
+			if (++n_agc_fallback <= 3) {
+				log_message(3, "[WARNING] Camera AGC expected but got raw video, re-applying");
+				applyAgcPolicy();
+			} else {
+				log_message(1, "[ERROR] Camera ignores AGC, tone mapping on the Pi");
 			}
 		}
 
@@ -282,6 +414,13 @@ void LeptonThread::run()
 
 		//lets emit the signal for update
 		emit updateImage(myImage);
+
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		m_raw.frameId++;
+		m_raw.frozen = frozen;
+		m_raw.timestampUs = (qint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+		emit updateRaw(m_raw);
 	}
 	
 	//finally, close SPI port just bcuz
@@ -289,8 +428,37 @@ void LeptonThread::run()
 }
 
 void LeptonThread::performFFC() {
-	//perform FFC
-	lepton_perform_ffc();
+	//perform FFC, without blocking the caller when the worker is available
+	if (m_cci) {
+		m_cci->ffc();
+	} else {
+		lepton_perform_ffc();
+	}
+}
+
+void LeptonThread::setFfcFreeze(bool on)
+{
+	if (!on && m_ffcFreeze) m_ffcSettle = FFC_SETTLE_FRAMES;
+	m_ffcFreeze = on;
+}
+
+void LeptonThread::setToneMapping(int mode, double plateau, double clip)
+{
+	m_tonePlateau = plateau;
+	m_toneClip = clip;
+	m_toneMode = mode;
+}
+
+void LeptonThread::setAutoRangeTuning(double clipPercent, double smoothing, double hysteresis)
+{
+	m_rangeClip = clipPercent;
+	m_rangeSmooth = smoothing;
+	m_rangeHyst = hysteresis;
+}
+
+void LeptonThread::setCci(CciWorker* cci)
+{
+	m_cci = cci;
 }
 
 void LeptonThread::log_message(uint16_t level, std::string msg)
@@ -302,6 +470,104 @@ void LeptonThread::log_message(uint16_t level, std::string msg)
 
 void LeptonThread::setBackgroundMode(const QString& mode)
 {
-    m_backgroundMode = mode.toLower();
+    bool blackBg = (mode.toLower() == "black");
+    if (blackBg == m_blackBg) return;
+    m_blackBg = blackBg;
+    m_lutDirty = true;
+    // the camera keeps its own copy of the palette
+    if (m_rgbWanted) applyVideoFormat();
+}
+
+void LeptonThread::buildPaletteLut(const int *colormap, int colormapSize, QRgb *lut)
+{
+	const bool blackBg = m_blackBg;
+	for (int value = 0; value <= 256; value++) {
+		int ofs_r = 3 * value + 0; if (colormapSize <= ofs_r) ofs_r = colormapSize - 1;
+		int ofs_g = 3 * value + 1; if (colormapSize <= ofs_g) ofs_g = colormapSize - 1;
+		int ofs_b = 3 * value + 2; if (colormapSize <= ofs_b) ofs_b = colormapSize - 1;
+		QRgb color = qRgb(colormap[ofs_r], colormap[ofs_g], colormap[ofs_b]);
+
+		// black background: grayscale (R==G==B) palette entries become black,
+		// grey background keeps them
+		if (blackBg && qRed(color) == qGreen(color) && qGreen(color) == qBlue(color)) {
+			color = qRgb(0, 0, 0);
+		}
+
+		// pure black is keyed out here, so the compositor can blend the layer as-is
+		if ((color & 0x00ffffff) == 0) {
+			color = qRgba(0, 0, 0, 0);
+		}
+		lut[value] = color;
+	}
+}
+
+void LeptonThread::setAgcPolicy(int policy)
+{
+	m_agcPolicy = policy;
+	// RGB888 needs AGC; the video format request sets it up
+	if (m_rgbWanted) applyVideoFormat();
+	else applyAgcPolicy();
+}
+
+void LeptonThread::setVideoRgb888(bool on)
+{
+	m_rgbWanted = on;
+	applyVideoFormat();
+}
+
+void LeptonThread::applyVideoFormat()
+{
+	const int gen = ++m_videoGen;
+	const bool rgb = m_rgbWanted;
+	const int policy = m_agcPolicy;
+	std::vector<QRgb> lut(257);
+	buildPaletteLut(selectedColormap, selectedColormapSize, lut.data());
+
+	// the capture loop switches packet size once the camera has switched
+	auto done = [this, gen, rgb](bool ok, int status) {
+		if (gen != m_videoGen) return; // a newer request decides
+		if (!ok) log_message(1, "[ERROR] Setting camera video format failed: " + std::to_string(status));
+		m_cameraRgb = (ok && rgb);
+		if (!rgb) {
+			m_cameraAgc = false;
+			applyAgcPolicy();
+		}
+	};
+
+	if (!m_cci) {
+		int status = rgb ? lepton_set_rgb888(policy, lut.data()) : lepton_set_raw14();
+		done(status == 0, status);
+		return;
+	}
+	m_cci->setVideoFormat(rgb, policy, lut, [this, done](const CciWorker::Result& r) {
+		if (r.coalesced) {
+			// joined an earlier request, which carried an older LUT
+			applyVideoFormat();
+			return;
+		}
+		done(r.ok, r.status);
+	});
+}
+
+void LeptonThread::applyAgcPolicy()
+{
+	const int policy = m_agcPolicy;
+	// raw frames decode fine either way, so drop the fast path right away
+	if (policy == 0) m_cameraAgc = false;
+
+	if (!m_cci) {
+		m_cameraAgc = (lepton_set_agc(policy) == 0 && policy != 0);
+		return;
+	}
+	m_cci->setAgc(policy, [this, policy](const CciWorker::Result& r) {
+		if (r.coalesced || policy != m_agcPolicy) {
+			// joined an earlier request, which may have run before a policy
+			// queued in between, or the policy changed while this one was queued
+			applyAgcPolicy();
+			return;
+		}
+		if (!r.ok) log_message(1, "[ERROR] Setting camera AGC failed: " + std::to_string(r.status));
+		m_cameraAgc = (r.ok && policy != 0);
+	});
 }
 
@@ -3,6 +3,7 @@
 
 #include <ctime>
 #include <stdint.h>
+#include <atomic>
 
 #include <QThread>
 #include <QtCore>
@@ -10,11 +11,18 @@
 #include <QImage>
 #include <QString>
 
+#include "RawFrame.h"
+#include "ToneMapper.h"
+#include "AutoRange.h"
+
 #define PACKET_SIZE 164
 #define PACKET_SIZE_UINT16 (PACKET_SIZE/2)
+#define PACKET_SIZE_RGB888 244 // 4 header bytes + 80 pixels * 3
 #define PACKETS_PER_FRAME 60
 #define FRAME_SIZE_UINT16 (PACKET_SIZE_UINT16*PACKETS_PER_FRAME)
 
+class CciWorker;
+
 class LeptonThread : public QThread
 {
   Q_OBJECT;
@@ -31,6 +39,24 @@ public:
   void useRangeMinValue(uint16_t);
   void useRangeMaxValue(uint16_t);
   void setBackgroundMode(const QString& mode);
+  // CCI commands (FFC, reboot) go through this worker when set
+  void setCci(CciWorker* cci);
+  // 0: tone map on the Pi from raw 14-bit video; 1/2: the camera runs
+  // linear/HEQ AGC and sends 8-bit video that maps straight to the palette
+  void setAgcPolicy(int policy);
+  // the camera colours the video itself (RGB888 VoSPI) with the selected
+  // palette uploaded as its user LUT; no raw frames are emitted meanwhile
+  void setVideoRgb888(bool on);
+  // set around an FFC: frozen frames, and a few after, keep the auto range
+  // and are flagged in RawFrame so consumers can skip them too
+  void setFfcFreeze(bool on);
+  // -1: linear min/max stretch; otherwise a ToneMapper::Mode applied to the
+  // raw frame (plateau in percent of pixels, clip as ToneMapper); raw video only
+  void setToneMapping(int mode, double plateau, double clip);
+  // linear auto range: percent of outlier pixels dropped at each end, EMA
+  // weight of the newest frame, and the share of the span it must drift
+  // before the palette follows (see AutoRange)
+  void setAutoRangeTuning(double clipPercent, double smoothing, double hysteresis);
   void run();
 
 public slots:
@@ -39,10 +65,14 @@ public slots:
 signals:
   void updateText(QString);
   void updateImage(QImage);
+  void updateRaw(RawFrame);
 
 private:
 
   void log_message(uint16_t, std::string);
+  void applyAgcPolicy();
+  void applyVideoFormat();
+  void buildPaletteLut(const int *colormap, int colormapSize, QRgb *lut);
   uint16_t loglevel;
   int typeColormap;
   const int *selectedColormap;
@@ -56,10 +86,32 @@ private:
   int myImageWidth;
   int myImageHeight;
   QImage myImage;
-  QString m_backgroundMode = "black";
+  RawFrame m_raw;
+  std::atomic<bool> m_blackBg{true};
+  std::atomic<bool> m_lutDirty{true};
+  // palette index 0..255 -> overlay pixel, background keying included;
+  // [256] is the colour for values above the range
+  QRgb m_lut[257];
+  CciWorker *m_cci = nullptr;
+  std::atomic<int> m_agcPolicy{0};
+  std::atomic<bool> m_cameraAgc{false}; // the camera confirmed 8-bit AGC output
+  std::atomic<bool> m_rgbWanted{false};
+  std::atomic<bool> m_cameraRgb{false}; // the camera confirmed RGB888 output
+  std::atomic<int> m_videoGen{0};       // newest setVideoRgb888/LUT request
+  std::atomic<bool> m_ffcFreeze{false};
+  std::atomic<int> m_ffcSettle{0};      // frames still to skip after an FFC
+  std::atomic<int> m_toneMode{-1};
+  std::atomic<double> m_tonePlateau{5.0};
+  std::atomic<double> m_toneClip{3.0};
+  ToneMapper m_tone;                    // capture thread only
+  std::vector<uint8_t> m_toneIdx;       // palette index per pixel
+  std::atomic<double> m_rangeClip{0.05};
+  std::atomic<double> m_rangeSmooth{0.25};
+  std::atomic<double> m_rangeHyst{0.02};
+  AutoRange m_range;                    // capture thread only
 
-  uint8_t result[PACKET_SIZE*PACKETS_PER_FRAME];
-  uint8_t shelf[4][PACKET_SIZE*PACKETS_PER_FRAME];
+  uint8_t result[PACKET_SIZE_RGB888*PACKETS_PER_FRAME];
+  uint8_t shelf[4][PACKET_SIZE_RGB888*PACKETS_PER_FRAME];
   uint16_t *frameBuffer;
 
 };
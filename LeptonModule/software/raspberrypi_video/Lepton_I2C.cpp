@@ -3,6 +3,8 @@
 #include "leptonSDKEmb32PUB/LEPTON_SDK.h"
 #include "leptonSDKEmb32PUB/LEPTON_SYS.h"
 #include "leptonSDKEmb32PUB/LEPTON_OEM.h"
+#include "leptonSDKEmb32PUB/LEPTON_AGC.h"
+#include "leptonSDKEmb32PUB/LEPTON_VID.h"
 #include "leptonSDKEmb32PUB/LEPTON_Types.h"
 
 bool _connected;
@@ -10,23 +12,101 @@ bool _connected;
 LEP_CAMERA_PORT_DESC_T _port;
 
 int lepton_connect() {
-	LEP_OpenPort(1, LEP_CCI_TWI, 400, &_port);
-	_connected = true;
-	return 0;
+	LEP_RESULT result = LEP_OpenPort(1, LEP_CCI_TWI, 400, &_port);
+	_connected = (result == LEP_OK);
+	return result;
 }
 
-void lepton_perform_ffc() {
+int lepton_perform_ffc() {
 	if(!_connected) {
-		lepton_connect();
+		int result = lepton_connect();
+		if (result != LEP_OK) return result;
 	}
-	LEP_RunSysFFCNormalization(&_port);
+	return LEP_RunSysFFCNormalization(&_port);
 }
 
 //presumably more commands could go here if desired
 
-void lepton_reboot() {
+int lepton_reboot() {
 	if(!_connected) {
-		lepton_connect();
+		int result = lepton_connect();
+		if (result != LEP_OK) return result;
 	}
-	LEP_RunOemReboot(&_port);
+	return LEP_RunOemReboot(&_port);
+}
+
+int lepton_set_agc(int policy) {
+	if(!_connected) {
+		int result = lepton_connect();
+		if (result != LEP_OK) return result;
+	}
+	if (policy == 0) {
+		return LEP_SetAgcEnableState(&_port, LEP_AGC_DISABLE);
+	}
+	LEP_RESULT result = LEP_SetAgcPolicy(&_port, policy == 2 ? LEP_AGC_HEQ : LEP_AGC_LINEAR);
+	if (result != LEP_OK) return result;
+	return LEP_SetAgcEnableState(&_port, LEP_AGC_ENABLE);
+}
+
+int lepton_set_rgb888(int agcPolicy, const unsigned int *lut) {
+	LEP_RESULT result = (LEP_RESULT)lepton_set_agc(agcPolicy != 0 ? agcPolicy : 2);
+	if (result != LEP_OK) return result;
+
+	LEP_VID_LUT_BUFFER_T buf;
+	for (int i = 0; i < 256; i++) {
+		buf.bin[i].reserved = 0;
+		buf.bin[i].red = (lut[i] >> 16) & 0xff;
+		buf.bin[i].green = (lut[i] >> 8) & 0xff;
+		buf.bin[i].blue = lut[i] & 0xff;
+	}
+	result = LEP_SetVidUserLut(&_port, &buf);
+	if (result != LEP_OK) return result;
+	result = LEP_SetVidPcolorLut(&_port, LEP_VID_USER_LUT);
+	if (result != LEP_OK) return result;
+	return LEP_SetOemVideoOutputFormat(&_port, LEP_VIDEO_OUTPUT_FORMAT_RGB888);
+}
+
+int lepton_set_raw14() {
+	if(!_connected) {
+		int result = lepton_connect();
+		if (result != LEP_OK) return result;
+	}
+	return LEP_SetOemVideoOutputFormat(&_port, LEP_VIDEO_OUTPUT_FORMAT_RAW14);
+}
+
+int lepton_get_ffc_state(LeptonFfcState *state) {
+	if(!_connected) {
+		int result = lepton_connect();
+		if (result != LEP_OK) return result;
+	}
+	LEP_SYS_STATUS_E status;
+	LEP_RESULT result = LEP_GetSysFFCStatus(&_port, &status);
+	if (result != LEP_OK) return result;
+	LEP_SYS_FFC_SHUTTER_MODE_OBJ_T mode;
+	result = LEP_GetSysFfcShutterModeObj(&_port, &mode);
+	if (result != LEP_OK) return result;
+	LEP_SYS_FPA_TEMPERATURE_KELVIN_T fpa;
+	result = LEP_GetSysFpaTemperatureKelvin(&_port, &fpa);
+	if (result != LEP_OK) return result;
+
+	state->status = status;
+	state->desired = (mode.ffcDesired == LEP_SYS_ENABLE);
+	state->msSinceFfc = mode.elapsedTimeSinceLastFfc;
+	state->fpaKelvin = fpa / 100.0f;
+	return LEP_OK;
+}
+
+int lepton_set_ffc_mode(bool automatic, unsigned int periodMs, unsigned int tempDeltaCentiK) {
+	if(!_connected) {
+		int result = lepton_connect();
+		if (result != LEP_OK) return result;
+	}
+	LEP_SYS_FFC_SHUTTER_MODE_OBJ_T mode;
+	LEP_RESULT result = LEP_GetSysFfcShutterModeObj(&_port, &mode);
+	if (result != LEP_OK) return result;
+	mode.shutterMode = automatic ? LEP_SYS_FFC_SHUTTER_MODE_AUTO : LEP_SYS_FFC_SHUTTER_MODE_MANUAL;
+	mode.videoFreezeDuringFFC = LEP_SYS_ENABLE;
+	mode.desiredFfcPeriod = periodMs;
+	mode.desiredFfcTempDelta = tempDeltaCentiK;
+	return LEP_SetSysFfcShutterModeObj(&_port, mode);
 }
@@ -1,7 +1,28 @@
 #ifndef LEPTON_I2C
 #define LEPTON_I2C
 
-void lepton_perform_ffc();
-void lepton_reboot();
+// Blocking CCI calls, each returns a LEP_RESULT (0 = LEP_OK).
+// Run them through CciWorker rather than from the GUI or capture thread.
+int lepton_perform_ffc();
+int lepton_reboot();
+// 0: AGC off (raw 14-bit video), 1: linear AGC, 2: HEQ AGC (8-bit video)
+int lepton_set_agc(int policy);
+// RGB888 video coloured on the camera through its user LUT (256 0xAARRGGBB
+// entries, alpha ignored). Needs AGC, so policy 0 selects HEQ here.
+int lepton_set_rgb888(int agcPolicy, const unsigned int *lut);
+// back to RAW14 video; the AGC state is left to lepton_set_agc()
+int lepton_set_raw14();
+
+// what an FFC scheduler needs from the camera, read in one go
+struct LeptonFfcState {
+	int status;               // LEP_SYS_STATUS_E, 1 while an FFC runs
+	bool desired;             // the camera's own schedule asks for an FFC
+	unsigned int msSinceFfc;
+	float fpaKelvin;
+};
+int lepton_get_ffc_state(LeptonFfcState *state);
+// auto: the camera runs FFC on its own schedule (periodMs, tempDeltaCentiK);
+// otherwise only on request, with ffcDesired still raised by that schedule
+int lepton_set_ffc_mode(bool automatic, unsigned int periodMs, unsigned int tempDeltaCentiK);
 
 #endif
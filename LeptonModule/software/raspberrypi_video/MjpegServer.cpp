@@ -1,54 +1,146 @@
 #include "MjpegServer.h"
 #include "MyLabel.h"
 #include "Config.h"
+#include "PixelFormat.h"
+#include "CciWorker.h"
+#include "FfcController.h"
 
 #include <QDateTime>
+#include <QDebug>
 #include <QImage>
 #include <QTimer>
 #include <QUrlQuery>
 #include <QCoreApplication>
 #include <QDir>
-#include <QFileInfo>
 #include <QBuffer>
+#include <QPainter>
 #include <QJsonObject>
+#include <QJsonArray>
 #include <QJsonDocument>
 
 
 QByteArray MjpegServer::configJson() const
 {
-    if (!m_cfg) return "{}";
-
     QJsonObject root;
-    root["background"] = m_cfg->background;
+    root["background"] = m_cfg.background;
 
     QJsonObject usb;
-    usb["enabled"]  = m_cfg->usb.enabled;
-    usb["device"]   = m_cfg->usb.device;
-    usb["width"]    = m_cfg->usb.width;
-    usb["height"]   = m_cfg->usb.height;
-    usb["fps"]      = m_cfg->usb.fps;
-    usb["emboss"]   = m_cfg->usb.emboss;
-    usb["offset_x"] = m_cfg->usb.xform.offset_x;
-    usb["offset_y"] = m_cfg->usb.xform.offset_y;
-    usb["scale"]    = m_cfg->usb.xform.scale;
-    usb["opacity"]  = m_cfg->usb.xform.opacity;
-    usb["rotate"]   = m_cfg->usb.xform.rotate_deg;
-    usb["flip_h"]   = m_cfg->usb.xform.flip_h;
-    usb["flip_v"]   = m_cfg->usb.xform.flip_v;
+    usb["enabled"]  = m_cfg.usb.enabled;
+    usb["device"]   = m_cfg.usb.device;
+    usb["width"]    = m_cfg.usb.width;
+    usb["height"]   = m_cfg.usb.height;
+    usb["fps"]      = m_cfg.usb.fps;
+    usb["emboss"]   = m_cfg.usb.emboss;
+    usb["emboss_threshold"] = m_cfg.usb.emboss_threshold;
+    usb["emboss_thin"] = m_cfg.usb.emboss_thin;
+    usb["emboss_width"] = m_cfg.usb.emboss_width;
+    usb["emboss_height"] = m_cfg.usb.emboss_height;
+    usb["offset_x"] = m_cfg.usb.xform.offset_x;
+    usb["offset_y"] = m_cfg.usb.xform.offset_y;
+    usb["scale"]    = m_cfg.usb.xform.scale;
+    usb["opacity"]  = m_cfg.usb.xform.opacity;
+    usb["rotate"]   = m_cfg.usb.xform.rotate_deg;
+    usb["flip_h"]   = m_cfg.usb.xform.flip_h;
+    usb["flip_v"]   = m_cfg.usb.xform.flip_v;
     root["usb_cam"] = usb;
 
     QJsonObject th;
-    th["enabled"]  = m_cfg->thermal.enabled;
-    th["smooth"]   = m_cfg->thermal.smooth;
-    th["offset_x"] = m_cfg->thermal.xform.offset_x;
-    th["offset_y"] = m_cfg->thermal.xform.offset_y;
-    th["scale"]    = m_cfg->thermal.xform.scale;
-    th["opacity"]  = m_cfg->thermal.xform.opacity;
-    th["rotate"]   = m_cfg->thermal.xform.rotate_deg;
-    th["flip_h"]   = m_cfg->thermal.xform.flip_h;
-    th["flip_v"]   = m_cfg->thermal.xform.flip_v;
+    th["enabled"]  = m_cfg.thermal.enabled;
+    th["smooth"]   = m_cfg.thermal.smooth;
+    th["agc"]      = m_cfg.thermal.agc;
+    th["video"]    = m_cfg.thermal.video;
+    th["tone"]     = m_cfg.thermal.tone;
+    th["tone_plateau"] = m_cfg.thermal.tone_plateau;
+    th["tone_clip"] = m_cfg.thermal.tone_clip;
+    th["range_clip"] = m_cfg.thermal.range_clip;
+    th["range_smooth"] = m_cfg.thermal.range_smooth;
+    th["range_hysteresis"] = m_cfg.thermal.range_hysteresis;
+    th["offset_x"] = m_cfg.thermal.xform.offset_x;
+    th["offset_y"] = m_cfg.thermal.xform.offset_y;
+    th["scale"]    = m_cfg.thermal.xform.scale;
+    th["opacity"]  = m_cfg.thermal.xform.opacity;
+    th["rotate"]   = m_cfg.thermal.xform.rotate_deg;
+    th["flip_h"]   = m_cfg.thermal.xform.flip_h;
+    th["flip_v"]   = m_cfg.thermal.xform.flip_v;
     root["thermal"] = th;
 
+    QJsonObject disp;
+    disp["fps"] = m_cfg.display.fps;
+    root["display"] = disp;
+
+    QJsonObject st;
+    st["quality"] = m_cfg.stream.quality;
+    st["subsampling"] = m_cfg.stream.subsampling;
+    st["max_buffered_kb"] = m_cfg.stream.max_buffered_kb;
+    root["stream"] = st;
+
+    QJsonObject ffc;
+    ffc["mode"]        = m_cfg.ffc.mode;
+    ffc["period_s"]    = m_cfg.ffc.period_s;
+    ffc["temp_delta"]  = m_cfg.ffc.temp_delta;
+    ffc["max_defer_s"] = m_cfg.ffc.max_defer_s;
+    ffc["quiet"]       = m_cfg.ffc.quiet;
+    root["ffc"] = ffc;
+
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+QByteArray MjpegServer::statsJson() const
+{
+    QJsonObject root;
+    root["pixel"] = PixelFormat::statsJson();
+
+    QJsonObject mj;
+    mj["clients"] = m_streams.size();
+    QJsonArray clients;
+    for (const StreamClient& c : m_streams) {
+        QJsonObject o;
+        o["peer"] = c.sock->peerAddress().toString() + ":" + QString::number(c.sock->peerPort());
+        o["fps_cap"] = c.intervalMs > 0 ? (int)(1000 / c.intervalMs) : 0;
+        o["sent"] = (double)c.sent;
+        o["dropped"] = (double)c.dropped;
+        o["queued_bytes"] = (double)c.sock->bytesToWrite();
+        clients.append(o);
+    }
+    mj["client_list"] = clients;
+    mj["encodes"] = (double)m_encodes;
+    mj["encoder_dropped"] = (double)m_encoder.droppedCount();
+    mj["encode_ms"] = m_encoder.lastEncodeMs();
+    root["mjpeg"] = mj;
+
+    QJsonObject raw;
+    raw["clients"] = m_rawStreams.size();
+    raw["frame_id"] = (double)m_rawFrameId;
+    QJsonArray rawClients;
+    for (const StreamClient& c : m_rawStreams) {
+        QJsonObject o;
+        o["peer"] = c.sock->peerAddress().toString() + ":" + QString::number(c.sock->peerPort());
+        o["sent"] = (double)c.sent;
+        o["dropped"] = (double)c.dropped;
+        o["queued_bytes"] = (double)c.sock->bytesToWrite();
+        rawClients.append(o);
+    }
+    raw["client_list"] = rawClients;
+    root["raw"] = raw;
+
+    QJsonObject ws;
+    ws["clients"] = m_ws.size();
+    root["websocket"] = ws;
+
+    QJsonObject snap;
+    snap["reused"] = (double)m_snapHits;
+    snap["encoded"] = (double)m_snapEncodes;
+    snap["waiting"] = m_snapWaiters.size();
+    root["snapshot"] = snap;
+
+    QJsonObject st;
+    st["files"] = m_static.count();
+    st["bytes"] = (double)m_static.bytes();
+    root["static"] = st;
+
+    if (m_source) root["display"] = m_source->scheduler().statsJson();
+    if (m_cci) root["cci"] = m_cci->statsJson();
+    if (m_ffc) root["ffc"] = m_ffc->statsJson();
     return QJsonDocument(root).toJson(QJsonDocument::Compact);
 }
 
@@ -62,43 +154,6 @@ QByteArray MjpegServer::loadConfigJson()
     return f.readAll();
 }
 
-static QByteArray mimeFor(const QString& fn)
-{
-    QString f = fn.toLower();
-    if (f.endsWith(".html")) return "text/html; charset=utf-8";
-    if (f.endsWith(".css"))  return "text/css; charset=utf-8";
-    if (f.endsWith(".js"))   return "application/javascript; charset=utf-8";
-    if (f.endsWith(".png"))  return "image/png";
-    if (f.endsWith(".jpg") || f.endsWith(".jpeg")) return "image/jpeg";
-    if (f.endsWith(".svg"))  return "image/svg+xml";
-    return "application/octet-stream";
-}
-
-QByteArray MjpegServer::loadStatic(const QByteArray& urlPath, QByteArray* outContentType)
-{
-    // URL -> filesystem under <appdir>/webapp
-    QString appDir = QCoreApplication::applicationDirPath();
-    QString webRoot = QDir(appDir).filePath("webapp");
-
-    QString p = QString::fromUtf8(urlPath);
-    if (p == "/" || p.isEmpty()) p = "/index.html";
-    if (p.startsWith("/")) p = p.mid(1);
-
-    // prevent traversal
-    p = QDir::cleanPath(p);
-    if (p.startsWith("..")) return QByteArray();
-
-    QString full = QDir(webRoot).filePath(p);
-    QFileInfo fi(full);
-    if (!fi.exists() || !fi.isFile()) return QByteArray();
-
-    QFile f(full);
-    if (!f.open(QIODevice::ReadOnly)) return QByteArray();
-
-    if (outContentType) *outContentType = mimeFor(full);
-    return f.readAll();
-}
-
 bool MjpegServer::writeFifoLine(const QByteArray& line)
 {
     QFile f("/tmp/lepton_cmd");
@@ -109,11 +164,14 @@ bool MjpegServer::writeFifoLine(const QByteArray& line)
     return true;
 }
 
-static QByteArray httpResponse(const QByteArray& body, const QByteArray& contentType = "text/html; charset=utf-8")
+static QByteArray httpResponse(const QByteArray& body,
+                               const QByteArray& contentType = "text/html; charset=utf-8",
+                               bool keepAlive = false,
+                               const QByteArray& status = "200 OK")
 {
     QByteArray h;
-    h += "HTTP/1.1 200 OK\r\n";
-    h += "Connection: close\r\n";
+    h += "HTTP/1.1 " + status + "\r\n";
+    h += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
     h += "Cache-Control: no-cache\r\n";
     h += "Pragma: no-cache\r\n";
     h += "Content-Type: " + contentType + "\r\n";
@@ -122,10 +180,179 @@ static QByteArray httpResponse(const QByteArray& body, const QByteArray& content
     return h + body;
 }
 
-MjpegServer::MjpegServer(MyLabel* source, AppCfg* cfg, quint16 port, QObject* parent)
-    : QTcpServer(parent), m_source(source), m_cfg(cfg), m_port(port)
+MjpegServer::MjpegServer(MyLabel* source, const AppCfg& cfg, quint16 port, QObject* parent)
+    : QTcpServer(parent), m_source(source), m_cfg(cfg), m_port(port),
+      m_static(QDir(QCoreApplication::applicationDirPath()).filePath("webapp"))
 {
-    listen(QHostAddress::Any, m_port);
+    // members that are QObjects follow the server to its thread as children
+    m_pumpTimer.setParent(this);
+    m_static.setParent(this);
+
+    m_clock.start();
+    m_pumpTimer.setSingleShot(true);
+    QObject::connect(&m_pumpTimer, &QTimer::timeout, this, &MjpegServer::pump);
+    if (m_source)
+        QObject::connect(m_source, &MyLabel::compositeReady, this, &MjpegServer::onCompositeReady);
+
+    // queued: encoded() is emitted on the encoder thread
+    QObject::connect(&m_encoder, &JpegEncoder::encoded, this, &MjpegServer::onEncoded,
+                     Qt::QueuedConnection);
+}
+
+void MjpegServer::start()
+{
+    m_encoder.start(QThread::LowPriority);
+    if (!listen(QHostAddress::Any, m_port))
+        qWarning() << "HTTP server: cannot listen on port" << m_port << errorString();
+}
+
+void MjpegServer::setConfig(const AppCfg& cfg)
+{
+    m_cfg = cfg;
+}
+
+MjpegServer::~MjpegServer()
+{
+    m_encoder.stop();
+    m_encoder.wait();
+}
+
+void MjpegServer::onCompositeReady(quint64 seq)
+{
+    m_latestSeq = seq;
+    pump();
+}
+
+void MjpegServer::schedulePump(qint64 dueMs)
+{
+    qint64 wait = qMax<qint64>(1, dueMs - m_clock.elapsed());
+    if (!m_pumpTimer.isActive() || m_pumpTimer.remainingTime() > wait)
+        m_pumpTimer.start((int)wait);
+}
+
+// Hand the newest composite to the encoder unless every client would still
+// be inside its fps interval, then push whatever is already encoded.
+void MjpegServer::pump()
+{
+    if (m_streams.isEmpty() || !m_source) return;
+
+    if (m_latestSeq != m_submittedSeq) {
+        qint64 minInterval = m_streams.first().intervalMs;
+        for (const StreamClient& c : m_streams)
+            minInterval = qMin(minInterval, c.intervalMs);
+
+        qint64 now = m_clock.elapsed();
+        if (m_lastSubmitMs < 0 || now - m_lastSubmitMs >= minInterval) {
+            quint64 seq = 0;
+            QImage img = m_source->getLastComposite(&seq);
+            if (!img.isNull()) {
+                m_encoder.setParams(m_cfg.stream.quality, m_cfg.stream.subsampling);
+                m_encoder.submit(img, seq);
+                m_submittedSeq = seq;
+                m_latestSeq = seq;
+                m_lastSubmitMs = now;
+            }
+        } else {
+            schedulePump(m_lastSubmitMs + minInterval);
+        }
+    }
+
+    deliver();
+}
+
+void MjpegServer::onEncoded(const QByteArray& jpg, quint64 seq)
+{
+    answerSnapshotWaiters(jpg, seq);
+    if (jpg.isEmpty()) return;
+
+    QByteArray part;
+    part.reserve(jpg.size() + 96);
+    part += "--frame\r\n";
+    part += "Content-Type: image/jpeg\r\n";
+    part += "Content-Length: " + QByteArray::number(jpg.size()) + "\r\n";
+    part += "\r\n";
+    part += jpg;
+    part += "\r\n";
+
+    m_part = part;
+    m_wsPart = WebSocket::frame(WebSocket::Binary, jpg);
+    m_jpeg = jpg;
+    m_partSeq = seq;
+    m_encodes++;
+    deliver();
+}
+
+qint64 MjpegServer::maxQueuedBytes() const
+{
+    return (qint64)m_cfg.stream.max_buffered_kb * 1024;
+}
+
+// A client whose queue would grow past the cap skips this part; it gets the
+// newest one once bytesWritten() has drained its queue. A part is always
+// accepted into an empty queue so large frames still flow.
+bool MjpegServer::sendPart(StreamClient& c, const QByteArray& part, quint64 seq, qint64 maxQueued)
+{
+    qint64 queued = c.sock->bytesToWrite();
+    if (queued > 0 && queued + part.size() > maxQueued) {
+        if (c.droppedSeq != seq) {
+            c.droppedSeq = seq;
+            c.dropped++;
+        }
+        return false;
+    }
+    // a single write of the shared QByteArray lets QTcpSocket queue it without a copy
+    c.sock->write(part);
+    c.lastSeq = seq;
+    c.sent++;
+    return true;
+}
+
+void MjpegServer::deliver()
+{
+    if (m_part.isEmpty()) return;
+
+    const qint64 maxQueued = maxQueuedBytes();
+    qint64 now = m_clock.elapsed();
+    qint64 nextDue = -1;
+    for (StreamClient& c : m_streams) {
+        if (c.lastSeq == m_partSeq || !c.sock->isOpen()) continue; // already has it
+        if (c.lastSentMs >= 0 && now - c.lastSentMs < c.intervalMs) {
+            qint64 due = c.lastSentMs + c.intervalMs;
+            if (nextDue < 0 || due < nextDue) nextDue = due;
+            continue;
+        }
+        if (sendPart(c, c.ws ? m_wsPart : m_part, m_partSeq, maxQueued)) c.lastSentMs = now;
+    }
+    if (nextDue >= 0) schedulePump(nextDue);
+}
+
+void MjpegServer::onRawFrame(const RawFrame& frame)
+{
+    if (frame.isNull()) return;
+    m_lastRaw = frame;
+    if (m_rawStreams.isEmpty()) return;
+
+    QByteArray payload = frame.serialize();
+    QByteArray part;
+    part.reserve(payload.size() + 96);
+    part += "--raw\r\n";
+    part += "Content-Type: application/octet-stream\r\n";
+    part += "Content-Length: " + QByteArray::number(payload.size()) + "\r\n";
+    part += "\r\n";
+    part += payload;
+    part += "\r\n";
+    m_rawPart = part;
+    m_wsRawPart = WebSocket::frame(WebSocket::Binary, payload);
+    m_rawFrameId = frame.frameId;
+
+    // the sensor rate is low (9 or 27 Hz), so a capped client just waits for the next frame
+    const qint64 maxQueued = maxQueuedBytes();
+    qint64 now = m_clock.elapsed();
+    for (StreamClient& c : m_rawStreams) {
+        if (!c.sock->isOpen()) continue;
+        if (c.lastSentMs >= 0 && now - c.lastSentMs < c.intervalMs) continue;
+        if (sendPart(c, c.ws ? m_wsRawPart : m_rawPart, m_rawFrameId, maxQueued)) c.lastSentMs = now;
+    }
 }
 
 void MjpegServer::incomingConnection(qintptr socketDescriptor)
@@ -142,38 +369,93 @@ void MjpegServer::handleClient(QTcpSocket* s)
 {
     s->setSocketOption(QAbstractSocket::LowDelayOption, 1);
 
-    QObject::connect(s, &QTcpSocket::readyRead, this, [this, s]() {
-        QByteArray req = s->readAll();
+    // catch a slow stream client up with the newest frame once its queue drains
+    QObject::connect(s, &QTcpSocket::bytesWritten, this, [this, s]() {
+        if (s->bytesToWrite() == 0 && !m_streams.isEmpty()) deliver();
+    });
 
-        // very small parser: first line only
-        int eol = req.indexOf("\r\n");
-        if (eol < 0) return;
-        QByteArray first = req.left(eol);
-        // Example: "GET /mjpeg HTTP/1.1"
-        QList<QByteArray> parts = first.split(' ');
-        if (parts.size() < 2) return;
+    m_http.insert(s, HttpParser());
+    QObject::connect(s, &QTcpSocket::readyRead, this, [this, s]() { onHttpData(s); });
+    QObject::connect(s, &QTcpSocket::disconnected, this, [this, s]() { unsubscribe(s); });
+    QObject::connect(s, &QTcpSocket::disconnected, s, &QTcpSocket::deleteLater);
+}
 
-        QByteArray url = parts[1];    // keep full URL including ?query
-        QByteArray path = url;        // route path (no query)
+void MjpegServer::onHttpData(QTcpSocket* s)
+{
+    if (m_ws.contains(s)) {
+        onWsData(s);
+        return;
+    }
 
-        int qpos = path.indexOf('?');
-        if (qpos >= 0)
-            path = path.left(qpos);
+    auto it = m_http.find(s);
+    if (it == m_http.end()) {
+        s->readAll(); // a stream socket: anything the client sends is ignored
+        return;
+    }
+    it->feed(s->readAll());
+
+    // keep pipelined responses in order behind a snapshot still being encoded
+    if (awaitingSnapshot(s)) return;
+
+    // answer pipelined requests in order until one needs more bytes
+    for (;;) {
+        HttpRequest req;
+        HttpParser::Status st = it->next(&req);
+        if (st == HttpParser::NeedMore) return;
+
+        if (st == HttpParser::Error) {
+            static const QHash<int, QByteArray> reasons = {
+                {400, "400 Bad Request"}, {413, "413 Payload Too Large"},
+                {431, "431 Request Header Fields Too Large"}, {501, "501 Not Implemented"}
+            };
+            QByteArray status = reasons.value(it->errorStatus(), "400 Bad Request");
+            m_http.erase(it);
+            s->write(httpResponse(status, "text/plain", false, status));
+            s->disconnectFromHost();
+            return;
+        }
 
+        if (!dispatch(s, req)) return;
+        it = m_http.find(s);
+        if (it == m_http.end()) return;
+    }
+}
 
-        // API: /api/config
-        if (path.startsWith("/api/config")) {
-            QByteArray body = configJson();
-            s->write(httpResponse(body, "application/json; charset=utf-8"));
-            s->flush();
+// Answers one request. Returns false when the connection is no longer a
+// plain request/response one: it became a stream or WebSocket, or it closes.
+bool MjpegServer::dispatch(QTcpSocket* s, const HttpRequest& req)
+{
+    const QByteArray& url = req.url;     // full URL including ?query
+    const QByteArray& path = req.path;   // route path (no query)
+    const bool keep = req.keepAlive();
+
+    auto reply = [&](const QByteArray& body, const QByteArray& ct, const QByteArray& status) {
+        s->write(httpResponse(body, ct, keep, status));
+        if (!keep) {
+            m_http.remove(s);
             s->disconnectFromHost();
-            return;
         }
+        return keep;
+    };
+
+    // API: /api/config
+    if (path.startsWith("/api/config")) {
+        return reply(configJson(), "application/json; charset=utf-8", "200 OK");
+    }
+
+
+    // API: /api/stats
+    if (path.startsWith("/api/stats")) {
+        return reply(statsJson(), "application/json; charset=utf-8", "200 OK");
+    }
 
 
-        // API: /api/cmd?line=...
-        if (path.startsWith("/api/cmd")) {
-            QByteArray line;
+    // API: /api/cmd?line=...  (or POST /api/cmd with the line as body)
+    if (path.startsWith("/api/cmd")) {
+        QByteArray line;
+        if (req.method == "POST") {
+            line = req.body;
+        } else {
             int q = url.indexOf('?');
             if (q >= 0) {
                 QByteArray qs = url.mid(q + 1);
@@ -190,83 +472,366 @@ void MjpegServer::handleClient(QTcpSocket* s)
                     }
                 }
             }
-
-            bool ok = (!line.trimmed().isEmpty()) && writeFifoLine(line);
-            QByteArray body = ok ? "{\"ok\":true}\n" : "{\"ok\":false}\n";
-            s->write(httpResponse(body, "application/json; charset=utf-8"));
-            s->flush();
-            s->disconnectFromHost();
-            return;
         }
 
+        bool ok = (!line.trimmed().isEmpty()) && writeFifoLine(line);
+        QByteArray body = ok ? "{\"ok\":true}\n" : "{\"ok\":false}\n";
+        return reply(body, "application/json; charset=utf-8", "200 OK");
+    }
 
-        if (path.startsWith("/mjpeg")) {
-            // Start MJPEG stream
-            QByteArray h;
-            h += "HTTP/1.1 200 OK\r\n";
-            h += "Connection: close\r\n";
-            h += "Cache-Control: no-cache\r\n";
-            h += "Pragma: no-cache\r\n";
-            h += "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n";
-            h += "\r\n";
-            s->write(h);
-            s->flush();
-
-            // stream timer
-            auto* t = new QTimer(s);
-            t->setInterval(100); // 10 fps (adjust later)
-            QObject::connect(t, &QTimer::timeout, this, [this, s]() {
-                if (!s->isOpen()) return;
-
-                QImage img = m_source ? m_source->getLastComposite() : QImage();
-                if (img.isNull()) return;
-
-                QByteArray jpg;
-                QBuffer buf(&jpg);
-                buf.open(QIODevice::WriteOnly);
-                img.convertToFormat(QImage::Format_RGB888).save(&buf, "JPG", 70);
-
-                QByteArray part;
-                part += "--frame\r\n";
-                part += "Content-Type: image/jpeg\r\n";
-                part += "Content-Length: " + QByteArray::number(jpg.size()) + "\r\n";
-                part += "\r\n";
-                s->write(part);
-                s->write(jpg);
-                s->write("\r\n");
-                s->flush();
-            });
-            t->start();
-
-            QObject::connect(s, &QTcpSocket::disconnected, t, &QTimer::deleteLater);
-            return;
-        }
 
-        // 404
-        // Static files from webapp
-        {
-            QByteArray ct;
-            QByteArray fileBody = loadStatic(path, &ct);
-            if (!fileBody.isEmpty()) {
-                s->write(httpResponse(fileBody, ct));
-                s->flush();
-                s->disconnectFromHost();
-                return;
-            }
-        }
+    if (path == "/ws") {
+        QByteArray rest = m_http[s].takeRemaining();
+        m_http.remove(s);
+        upgradeWebSocket(s, req, rest);
+        return false;
+    }
+
 
-        QByteArray notFound = "Not found";
+    if (path.startsWith("/raw")) {
+        // Raw 16-bit sensor stream, see RawFrame::serialize() for the part layout
         QByteArray h;
-        h += "HTTP/1.1 404 Not Found\r\n";
+        h += "HTTP/1.1 200 OK\r\n";
         h += "Connection: close\r\n";
-        h += "Content-Type: text/plain\r\n";
-        h += "Content-Length: " + QByteArray::number(notFound.size()) + "\r\n";
+        h += "Cache-Control: no-cache\r\n";
+        h += "Content-Type: multipart/x-mixed-replace; boundary=raw\r\n";
         h += "\r\n";
         s->write(h);
-        s->write(notFound);
         s->flush();
+
+        m_http.remove(s);
+        int fps = QUrlQuery(QString::fromUtf8(url.mid(url.indexOf('?') + 1)))
+                      .queryItemValue("fps").toInt();
+        subscribe(s, false, true, fps, false);
+        return false;
+    }
+
+
+    if (path.startsWith("/mjpeg")) {
+        // Start MJPEG stream
+        QByteArray h;
+        h += "HTTP/1.1 200 OK\r\n";
+        h += "Connection: close\r\n";
+        h += "Cache-Control: no-cache\r\n";
+        h += "Pragma: no-cache\r\n";
+        h += "Content-Type: multipart/x-mixed-replace; boundary=frame\r\n";
+        h += "\r\n";
+        s->write(h);
+        s->flush();
+
+        // subscribe to the shared stream; ?fps=N caps this client's rate
+        m_http.remove(s);
+        int fps = QUrlQuery(QString::fromUtf8(url.mid(url.indexOf('?') + 1)))
+                      .queryItemValue("fps").toInt();
+        subscribe(s, true, false, fps, false);
+        return false;
+    }
+
+    if (path.startsWith("/snapshot.")) {
+        return serveSnapshot(s, req, keep);
+    }
+
+
+    // Static files from webapp
+    if (const StaticCache::Asset* a = m_static.find(path)) {
+        // ?v=... marks a versioned URL whose content never changes
+        bool versioned = url.contains("?v=") || url.contains("&v=");
+        bool gzip = !a->gzip.isEmpty() && req.header("accept-encoding").contains("gzip");
+
+        QByteArray h;
+        if (req.header("if-none-match").contains(a->etag)) {
+            h += "HTTP/1.1 304 Not Modified\r\n";
+        } else {
+            h += "HTTP/1.1 200 OK\r\n";
+            h += "Content-Type: " + a->contentType + "\r\n";
+            if (gzip) h += "Content-Encoding: gzip\r\n";
+        }
+        h += keep ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+        h += "ETag: " + a->etag + "\r\n";
+        h += versioned ? "Cache-Control: public, max-age=31536000, immutable\r\n"
+                       : "Cache-Control: no-cache\r\n";
+        if (!a->gzip.isEmpty()) h += "Vary: Accept-Encoding\r\n";
+
+        bool notModified = h.startsWith("HTTP/1.1 304");
+        const QByteArray& body = gzip ? a->gzip : a->body;
+        h += "Content-Length: " + QByteArray::number(notModified ? 0 : body.size()) + "\r\n";
+        h += "\r\n";
+        s->write(h);
+        if (!notModified && req.method != "HEAD") s->write(body);
+        if (!keep) {
+            m_http.remove(s);
+            s->disconnectFromHost();
+        }
+        return keep;
+    }
+
+    // 404
+    return reply("Not found", "text/plain", "404 Not Found");
+}
+
+static QByteArray encodeImage(const QImage& img, const char* fmt, int quality)
+{
+    QByteArray out;
+    QBuffer buf(&out);
+    buf.open(QIODevice::WriteOnly);
+    img.save(&buf, fmt, quality);
+    return out;
+}
+
+// GET /snapshot.jpg|png|raw[?src=composite|thermal|camera][&native=1]
+// native=1 keeps a layer at sensor/capture size instead of the display size.
+// Returns false while the request waits for the encoder.
+bool MjpegServer::serveSnapshot(QTcpSocket* s, const HttpRequest& req, bool keep)
+{
+    auto finish = [&](const QByteArray& body, const QByteArray& ct, const QByteArray& status) {
+        QByteArray r = httpResponse(body, ct, keep, status);
+        if (req.method == "HEAD") r.chop(body.size());
+        s->write(r);
+        if (!keep) {
+            m_http.remove(s);
+            s->disconnectFromHost();
+        }
+        return keep;
+    };
+    auto unavailable = [&]() {
+        return finish("No frame yet", "text/plain", "503 Service Unavailable");
+    };
+
+    QByteArray ext = req.path.mid(10).toLower();
+    QUrlQuery q(QString::fromUtf8(req.url.mid(req.url.indexOf('?') + 1)));
+    QString src = q.queryItemValue("src").toLower();
+    QString nv = q.queryItemValue("native").toLower();
+    bool native = (nv == "1" || nv == "true");
+
+    if (ext == "raw") {
+        if (m_lastRaw.isNull()) return unavailable();
+        return finish(m_lastRaw.serialize(), "application/octet-stream", "200 OK");
+    }
+
+    bool png = (ext == "png");
+    if (!png && ext != "jpg" && ext != "jpeg")
+        return finish("Not found", "text/plain", "404 Not Found");
+    if (!m_source) return unavailable();
+
+    quint64 seq = 0;
+    QImage comp = m_source->getLastComposite(&seq);
+    const int quality = m_cfg.stream.quality;
+
+    if (src.isEmpty()) src = "composite";
+    const QString variant = QString("%1:%2:%3").arg(png ? "png" : "jpg", src).arg(native);
+    // reuses the last encode of this variant while its key is unchanged
+    auto encodeCached = [&](const QImage& img, qint64 imageKey) {
+        SnapEntry& e = m_snapCache[variant];
+        const int q = png ? -1 : quality;
+        if (e.body.isEmpty() || e.imageKey != imageKey || e.size != img.size() || e.quality != q) {
+            e.body = encodeImage(img, png ? "PNG" : "JPG", q);
+            e.imageKey = imageKey;
+            e.size = img.size();
+            e.quality = q;
+            m_snapEncodes++;
+        } else {
+            m_snapHits++;
+        }
+        return finish(e.body, png ? "image/png" : "image/jpeg", "200 OK");
+    };
+
+    if (src == "composite") {
+        if (comp.isNull()) return unavailable();
+        if (png) return encodeCached(comp, (qint64)seq);
+        if (!m_jpeg.isEmpty() && m_partSeq == seq) {
+            m_snapHits++;
+            return finish(m_jpeg, "image/jpeg", "200 OK");
+        }
+        // hand the composite to the stream encoder (unless it already has it)
+        // and answer from onEncoded
+        if (m_submittedSeq != seq) {
+            m_encoder.setParams(m_cfg.stream.quality, m_cfg.stream.subsampling);
+            m_encoder.submit(comp, seq);
+            m_submittedSeq = seq;
+            m_lastSubmitMs = m_clock.elapsed();
+        }
+        m_snapEncodes++;
+        m_snapWaiters.append({ s, keep, seq });
+        return false;
+    }
+
+    QImage img;
+    if (src == "thermal") img = m_source->getThermalImage();
+    else if (src == "camera") img = m_source->getCameraImage();
+    else return finish("src must be composite, thermal or camera", "text/plain", "400 Bad Request");
+    if (img.isNull()) return unavailable();
+    // the layer as handed out, before the scaling and flattening below
+    const qint64 imageKey = img.cacheKey();
+
+    if (!native && !comp.isNull())
+        img = img.scaled(comp.size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    if (!png && img.hasAlphaChannel()) {
+        // keyed-out thermal pixels are transparent; JPEG gets them black
+        QImage flat(img.size(), QImage::Format_RGB32);
+        flat.fill(Qt::black);
+        QPainter p(&flat);
+        p.drawImage(0, 0, img);
+        p.end();
+        img = flat;
+    }
+
+    return encodeCached(img, imageKey);
+}
+
+bool MjpegServer::awaitingSnapshot(QTcpSocket* s) const
+{
+    for (const SnapWaiter& w : m_snapWaiters)
+        if (w.sock == s) return true;
+    return false;
+}
+
+void MjpegServer::answerSnapshotWaiters(const QByteArray& jpg, quint64 seq)
+{
+    QList<QTcpSocket*> resume;
+    for (int i = 0; i < m_snapWaiters.size();) {
+        SnapWaiter w = m_snapWaiters[i];
+        if (w.seq > seq) { ++i; continue; }
+        m_snapWaiters.removeAt(i);
+
+        QByteArray r = jpg.isEmpty()
+            ? httpResponse("Encode failed", "text/plain", w.keepAlive, "500 Internal Server Error")
+            : httpResponse(jpg, "image/jpeg", w.keepAlive, "200 OK");
+        w.sock->write(r);
+        if (w.keepAlive) {
+            resume.append(w.sock);
+        } else {
+            m_http.remove(w.sock);
+            w.sock->disconnectFromHost();
+        }
+    }
+    // continue with requests that were pipelined behind the snapshot
+    for (QTcpSocket* s : resume) onHttpData(s);
+}
+
+// Adds s to the MJPEG and/or raw fan-out, replacing any earlier subscription.
+void MjpegServer::subscribe(QTcpSocket* s, bool mjpeg, bool raw, int fps, bool ws)
+{
+    for (int i = 0; i < m_streams.size(); ++i)
+        if (m_streams[i].sock == s) { m_streams.removeAt(i); break; }
+    for (int i = 0; i < m_rawStreams.size(); ++i)
+        if (m_rawStreams[i].sock == s) { m_rawStreams.removeAt(i); break; }
+
+    StreamClient c;
+    c.sock = s;
+    c.ws = ws;
+    if (fps > 0) c.intervalMs = 1000 / qBound(1, fps, 60);
+
+    if (raw) m_rawStreams.append(c);
+    if (mjpeg) {
+        m_streams.append(c);
+        // send the current frame right away instead of waiting for a change
+        pump();
+    }
+    if (m_streams.isEmpty()) m_pumpTimer.stop();
+}
+
+void MjpegServer::unsubscribe(QTcpSocket* s)
+{
+    subscribe(s, false, false, 0, false);
+    for (int i = m_snapWaiters.size() - 1; i >= 0; --i)
+        if (m_snapWaiters[i].sock == s) m_snapWaiters.removeAt(i);
+    m_ws.remove(s);
+    m_http.remove(s);
+}
+
+void MjpegServer::upgradeWebSocket(QTcpSocket* s, const HttpRequest& req, const QByteArray& rest)
+{
+    QByteArray key = req.header("sec-websocket-key");
+    if (key.isEmpty() || !req.header("upgrade").toLower().contains("websocket")) {
+        s->write(httpResponse("Expected a WebSocket upgrade", "text/plain", false,
+                              "400 Bad Request"));
         s->disconnectFromHost();
-    });
+        return;
+    }
 
-    QObject::connect(s, &QTcpSocket::disconnected, s, &QTcpSocket::deleteLater);
+    QByteArray h;
+    h += "HTTP/1.1 101 Switching Protocols\r\n";
+    h += "Upgrade: websocket\r\n";
+    h += "Connection: Upgrade\r\n";
+    h += "Sec-WebSocket-Accept: " + WebSocket::acceptKey(key) + "\r\n";
+    h += "\r\n";
+    s->write(h);
+
+    m_ws.insert(s, WebSocket::Parser());
+
+    // a client may send its first frame right behind the handshake
+    if (!rest.isEmpty()) {
+        m_ws[s].feed(rest);
+        onWsData(s);
+    }
+}
+
+void MjpegServer::onWsData(QTcpSocket* s)
+{
+    auto it = m_ws.find(s);
+    if (it == m_ws.end()) return;
+    it->feed(s->readAll());
+
+    WebSocket::Opcode op;
+    QByteArray payload;
+    while (it->next(&op, &payload)) {
+        switch (op) {
+        case WebSocket::Text:
+            onWsText(s, payload);
+            break;
+        case WebSocket::Ping:
+            s->write(WebSocket::frame(WebSocket::Pong, payload));
+            break;
+        case WebSocket::Close:
+            s->write(WebSocket::frame(WebSocket::Close, payload.left(2)));
+            unsubscribe(s);
+            s->disconnectFromHost();
+            return;
+        default:
+            break; // binary from the client and pongs are ignored
+        }
+        it = m_ws.find(s);
+        if (it == m_ws.end()) return;
+    }
+
+    if (it->error()) {
+        // 1002 protocol error
+        s->write(WebSocket::frame(WebSocket::Close, QByteArray("\x03\xea", 2)));
+        unsubscribe(s);
+        s->disconnectFromHost();
+    }
+}
+
+// Text messages are JSON objects, answered with a JSON object of a "type":
+//   {"cmd":"set thermal opacity 0.5","id":7}  -> {"type":"ack","ok":true,"id":7}
+//   {"get":"config"} / {"get":"stats"}        -> {"type":"config"|"stats","data":{...}}
+//   {"stream":"mjpeg|raw|both|none","fps":10} -> {"type":"stream","stream":"..."}
+void MjpegServer::onWsText(QTcpSocket* s, const QByteArray& text)
+{
+    QJsonObject msg = QJsonDocument::fromJson(text).object();
+    QJsonObject reply;
+
+    if (msg.contains("cmd")) {
+        QByteArray line = msg.value("cmd").toString().toUtf8();
+        reply["type"] = "ack";
+        reply["ok"] = !line.trimmed().isEmpty() && writeFifoLine(line);
+        if (msg.contains("id")) reply["id"] = msg.value("id");
+    } else if (msg.contains("get")) {
+        QString what = msg.value("get").toString();
+        QByteArray data = (what == "stats") ? statsJson() : configJson();
+        reply["type"] = (what == "stats") ? "stats" : "config";
+        reply["data"] = QJsonDocument::fromJson(data).object();
+    } else if (msg.contains("stream")) {
+        QString mode = msg.value("stream").toString();
+        bool mjpeg = (mode == "mjpeg" || mode == "both");
+        bool raw = (mode == "raw" || mode == "both");
+        subscribe(s, mjpeg, raw, msg.value("fps").toInt(), true);
+        reply["type"] = "stream";
+        reply["stream"] = mjpeg ? (raw ? "both" : "mjpeg") : (raw ? "raw" : "none");
+    } else {
+        reply["type"] = "error";
+        reply["error"] = "unknown message";
+    }
+
+    s->write(WebSocket::frame(WebSocket::Text, QJsonDocument(reply).toJson(QJsonDocument::Compact)));
 }
\ No newline at end of file
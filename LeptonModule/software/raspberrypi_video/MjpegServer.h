@@ -2,29 +2,141 @@
 #include <QObject>
 #include <QtNetwork/QTcpServer>
 #include <QtNetwork/QTcpSocket>
+#include <QTimer>
+#include <QList>
+#include <QElapsedTimer>
+#include "JpegEncoder.h"
+#include "RawFrame.h"
+#include "WebSocket.h"
+#include "HttpParser.h"
+#include "StaticCache.h"
+#include <QHash>
+#include <QSize>
+
+#include "Config.h"
 
 class MyLabel;
-struct AppCfg;
+class CciWorker;
+class FfcController;
 
 class MjpegServer : public QTcpServer {
     Q_OBJECT
 public:
+    // Runs on its own thread: construct, moveToThread(), then call start()
+    // from that thread (e.g. via QThread::started). source is only read
+    // through its locked getters and the compositeReady signal.
     explicit MjpegServer(MyLabel* source,
-                         AppCfg* cfg,
+                         const AppCfg& cfg,
                          quint16 port = 8080,
                          QObject* parent = nullptr);
+    ~MjpegServer() override;
+
+    // for /api/stats only; set before start()
+    void setCci(CciWorker* cci) { m_cci = cci; }
+    void setFfc(FfcController* ffc) { m_ffc = ffc; }
+
+public slots:
+    void start();
+    // the server keeps its own copy; pushed from the GUI thread on changes
+    void setConfig(const AppCfg& cfg);
+
+    // unpacked sensor frames for /raw, straight from LeptonThread
+    void onRawFrame(const RawFrame& frame);
 
 protected:
     void incomingConnection(qintptr socketDescriptor) override;
 
 private:
     MyLabel* m_source = nullptr;
-    AppCfg*  m_cfg    = nullptr;
+    AppCfg   m_cfg;
+    CciWorker* m_cci = nullptr;
+    FfcController* m_ffc = nullptr;
     quint16  m_port   = 8080;
+    StaticCache m_static;   // webapp/, loaded once and watched for changes
+
+    struct StreamClient {
+        QTcpSocket* sock = nullptr;
+        qint64 intervalMs = 0;  // from ?fps=N, 0 = every new composite
+        qint64 lastSentMs = -1;
+        quint64 lastSeq = 0;    // composite seq of the last part sent
+        quint64 droppedSeq = 0; // last seq skipped for backpressure (count once)
+        quint64 sent = 0;
+        quint64 dropped = 0;
+        bool ws = false;        // WebSocket client: gets the ws framed payload
+    };
+
+    // Streams are pushed when the compositor reports a new frame. Each new
+    // composite is encoded at most once (on m_encoder, off the GUI loop),
+    // at the rate of the fastest client, and the multipart part is shared.
+    QList<StreamClient> m_streams;
+    JpegEncoder m_encoder;
+    QElapsedTimer m_clock;
+    QTimer m_pumpTimer;         // single shot: next time a rate-limited client is due
+    QByteArray m_part;          // multipart chunk: boundary + headers + JPEG
+    QByteArray m_wsPart;        // the same JPEG as one WebSocket binary frame
+    QByteArray m_jpeg;          // the bare JPEG, reused by /snapshot.jpg while fresh
+    quint64 m_partSeq = 0;
+    quint64 m_latestSeq = 0;
+    quint64 m_submittedSeq = 0;
+    qint64 m_lastSubmitMs = -1;
+    quint64 m_encodes = 0;
+
+    void onCompositeReady(quint64 seq);
+    void onEncoded(const QByteArray& jpg, quint64 seq);
+    void pump();
+    void deliver();
+    void schedulePump(qint64 dueMs);
+    bool sendPart(StreamClient& c, const QByteArray& part, quint64 seq, qint64 maxQueued);
+    qint64 maxQueuedBytes() const;
+
+    // /raw: multipart of RawFrame::serialize() parts, one per sensor frame
+    QList<StreamClient> m_rawStreams;
+    QByteArray m_rawPart;
+    QByteArray m_wsRawPart;
+    quint32 m_rawFrameId = 0;
+    RawFrame m_lastRaw;         // for /snapshot.raw
+
+    // /snapshot.*: the composite JPEG comes from the stream encoder; a request
+    // for a composite newer than the last encode waits for the next one
+    struct SnapWaiter {
+        QTcpSocket* sock;
+        bool keepAlive;
+        quint64 seq;
+    };
+    QList<SnapWaiter> m_snapWaiters;
+    // every other variant keeps its last encode, keyed by "ext:src:native",
+    // and reuses it while the image behind it is unchanged
+    struct SnapEntry {
+        qint64 imageKey = 0;    // composite seq, or the layer's QImage::cacheKey()
+        QSize size;             // output size
+        int quality = -1;       // JPEG only
+        QByteArray body;
+    };
+    QHash<QString, SnapEntry> m_snapCache;
+    quint64 m_snapHits = 0;     // served from an earlier encode
+    quint64 m_snapEncodes = 0;  // needed an encode of their own
+    bool serveSnapshot(QTcpSocket* s, const HttpRequest& req, bool keep);
+    void answerSnapshotWaiters(const QByteArray& jpg, quint64 seq);
+    bool awaitingSnapshot(QTcpSocket* s) const;
+
+    // /ws: binary frames (JPEG or LRAW, told apart by their magic) out,
+    // JSON commands in, all on one connection
+    QHash<QTcpSocket*, WebSocket::Parser> m_ws;
+    void upgradeWebSocket(QTcpSocket* s, const HttpRequest& req, const QByteArray& rest);
+    void onWsData(QTcpSocket* s);
+    void onWsText(QTcpSocket* s, const QByteArray& text);
+    void subscribe(QTcpSocket* s, bool mjpeg, bool raw, int fps, bool ws);
+    void unsubscribe(QTcpSocket* s);
 
-    QByteArray loadStatic(const QByteArray& urlPath, QByteArray* outContentType);
     bool writeFifoLine(const QByteArray& line);
     QByteArray configJson() const;
+    QByteArray statsJson() const;
     QByteArray loadConfigJson();
     void handleClient(QTcpSocket* s);
+
+    // request/response sockets (keep-alive, pipelining); removed once a
+    // socket turns into a stream or WebSocket
+    QHash<QTcpSocket*, HttpParser> m_http;
+    void onHttpData(QTcpSocket* s);
+    bool dispatch(QTcpSocket* s, const HttpRequest& req);
 };
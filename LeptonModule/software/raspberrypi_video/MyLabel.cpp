@@ -1,10 +1,14 @@
 #include "MyLabel.h"
+#include "FbOutput.h"
+#include "PixelFormat.h"
 #include <QPainter>
 #include <QTransform>
 #include <QMutexLocker>
+#include <QElapsedTimer>
 
 MyLabel::MyLabel(QWidget *parent) : QLabel(parent)
 {
+    connect(&m_sched, &FrameScheduler::frameDue, this, &MyLabel::onFrameDue);
 }
 
 MyLabel::~MyLabel()
@@ -17,24 +21,49 @@ QImage MyLabel::getLastComposite() const
     return m_lastComposite;
 }
 
+QImage MyLabel::getLastComposite(quint64* seq) const
+{
+    QMutexLocker lk(&m_compMtx);
+    if (seq) *seq = m_compositeSeq;
+    return m_lastComposite;
+}
+
+QImage MyLabel::getThermalImage() const
+{
+    QMutexLocker lk(&m_compMtx);
+    return m_lastImage;
+}
+
+QImage MyLabel::getCameraImage() const
+{
+    QMutexLocker lk(&m_compMtx);
+    return m_camImage;
+}
+
 void MyLabel::setLogo(const QString &path, int heightPx, int marginPx)
 {
   m_logo = QPixmap(path);
   m_logoHeight = heightPx;
   m_logoMargin = marginPx;
-  update();
+  requestFrame();
 }
 
 void MyLabel::setImage(QImage image)
 {
-  m_lastImage = image;
-  update();
+  {
+    QMutexLocker lk(&m_compMtx);
+    m_lastImage = image;
+  }
+  requestFrame();
 }
 
 void MyLabel::setCameraImage(QImage img)
 {
-    m_camImage = img;
-    update();
+    {
+        QMutexLocker lk(&m_compMtx);
+        m_camImage = img;
+    }
+    requestFrame();
 }
 
 //void MyLabel::paintEvent(QPaintEvent *event)
@@ -54,62 +83,30 @@ void MyLabel::setCameraImage(QImage img)
 //    p.drawPixmap(x, y, scaled);
 //  }
 //}
-static QImage embossImage(const QImage& src)
+// Paint the full composite (camera, thermal, logo) at sz. Shared by the widget
+// path and the framebuffer path, which paints straight into a scanout page.
+void MyLabel::renderComposite(QPainter& p, const QSize& sz)
 {
-    QImage g = src.convertToFormat(QImage::Format_Grayscale8);
-    QImage out(g.size(), QImage::Format_Grayscale8);
-    out.fill(0); // black background
+    const int W = sz.width();
+    const int H = sz.height();
 
-    const int thr = 35; // edge threshold (tune 10..80)
-
-    for (int y = 1; y < g.height() - 1; ++y) {
-        const uchar* p0 = g.constScanLine(y - 1);
-        const uchar* p1 = g.constScanLine(y);
-        const uchar* p2 = g.constScanLine(y + 1);
-        uchar* d = out.scanLine(y);
-
-        for (int x = 1; x < g.width() - 1; ++x) {
-            // Sobel magnitude (approx)
-            int gx = -p0[x-1] + p0[x+1]
-                     -2*p1[x-1] + 2*p1[x+1]
-                     -p2[x-1] + p2[x+1];
-
-            int gy = -p0[x-1] -2*p0[x] -p0[x+1]
-                     +p2[x-1] +2*p2[x] +p2[x+1];
-
-            int mag = (qAbs(gx) + qAbs(gy)) / 8; // scale down
-            d[x] = (mag >= thr) ? 255 : 0;       // white edges, black background
-        }
-    }
-    return out;
-}
-
-
-
-void MyLabel::paintEvent(QPaintEvent *event)
-{
-    Q_UNUSED(event);
-
-    QImage frame(size(), QImage::Format_ARGB32);
-    frame.fill(0);
-
-    QPainter p(&frame);
     QColor uiBg = Qt::black;
-    p.fillRect(QRect(QPoint(0,0), size()), uiBg);
+    p.fillRect(QRect(QPoint(0,0), sz), uiBg);
 
     // 1) draw camera background
     if (m_cfg.usb.enabled && !m_camImage.isNull()) {
         p.save();
-        p.translate(width() / 2.0 + m_cfg.usb.xform.offset_x,
-                    height() / 2.0 + m_cfg.usb.xform.offset_y);
+        p.translate(W / 2.0 + m_cfg.usb.xform.offset_x,
+                    H / 2.0 + m_cfg.usb.xform.offset_y);
         p.rotate(m_cfg.usb.xform.rotate_deg);
         p.scale(m_cfg.usb.xform.scale, m_cfg.usb.xform.scale);
 
-        QImage cam = m_cfg.usb.emboss ? embossImage(m_camImage) : m_camImage;
+        // when emboss is on UsbCamThread already delivers Grayscale8 edges
+        QImage cam = m_camImage;
         if (m_cfg.usb.xform.flip_h || m_cfg.usb.xform.flip_v)
             cam = cam.mirrored(m_cfg.usb.xform.flip_h, m_cfg.usb.xform.flip_v);
 
-        QRectF target(-width() / 2.0, -height() / 2.0, width(), height());
+        QRectF target(-W / 2.0, -H / 2.0, W, H);
         p.setOpacity(m_cfg.usb.xform.opacity);
         p.drawImage(target, cam);
         p.restore();
@@ -117,37 +114,25 @@ void MyLabel::paintEvent(QPaintEvent *event)
 
     // 2) draw thermal overlay (black pixels become transparent if BLACK_BACKGROUND was used)
     if (m_cfg.thermal.enabled && !m_lastImage.isNull()) {
-        QImage a = m_lastImage.convertToFormat(QImage::Format_ARGB32);
-
-        // make pure-black transparent (this works only if thermal background is forced to black)
-        for (int y = 0; y < a.height(); y++) {
-            QRgb *line = reinterpret_cast<QRgb*>(a.scanLine(y));
-            for (int x = 0; x < a.width(); x++) {
-                QRgb c = line[x];
-                if ((qRed(c) | qGreen(c) | qBlue(c)) == 0) {
-                    line[x] = qRgba(0, 0, 0, 0);
-                } else {
-                    line[x] = qRgba(qRed(c), qGreen(c), qBlue(c), 255);
-                }
-            }
-        }
+        // LeptonThread delivers the overlay format with black already transparent
+        QImage a = PixelFormat::convert(m_lastImage, PixelFormat::Overlay, PixelFormat::SiteThermal);
 
         QImage scaled;
 
         if (m_cfg.thermal.smooth <= 0) {
-            scaled = a.scaled(size(), Qt::IgnoreAspectRatio, Qt::FastTransformation);
+            scaled = a.scaled(sz, Qt::IgnoreAspectRatio, Qt::FastTransformation);
         } else {
             // smooth 1..10 -> downscale factor ~ 0.85 .. 0.25
             double f = 1.0 - 0.06 * m_cfg.thermal.smooth;
             if (f < 0.25) f = 0.25;
 
-            QSize downSz(qMax(1, int(width() * f)), qMax(1, int(height() * f)));
+            QSize downSz(qMax(1, int(W * f)), qMax(1, int(H * f)));
             QImage down = a.scaled(downSz, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-            scaled = down.scaled(size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            scaled = down.scaled(sz, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
         }
         p.save();
-        p.translate(width() / 2.0 + m_cfg.thermal.xform.offset_x,
-                    height() / 2.0 + m_cfg.thermal.xform.offset_y);
+        p.translate(W / 2.0 + m_cfg.thermal.xform.offset_x,
+                    H / 2.0 + m_cfg.thermal.xform.offset_y);
         p.rotate(m_cfg.thermal.xform.rotate_deg);
         p.scale(m_cfg.thermal.xform.scale, m_cfg.thermal.xform.scale);
 
@@ -155,7 +140,7 @@ void MyLabel::paintEvent(QPaintEvent *event)
         if (m_cfg.thermal.xform.flip_h || m_cfg.thermal.xform.flip_v)
             th = th.mirrored(m_cfg.thermal.xform.flip_h, m_cfg.thermal.xform.flip_v);
 
-        QRectF target(-width() / 2.0, -height() / 2.0, width(), height());
+        QRectF target(-W / 2.0, -H / 2.0, W, H);
         p.setOpacity(m_cfg.thermal.xform.opacity);
         p.drawImage(target, th);
         p.restore();
@@ -164,22 +149,92 @@ void MyLabel::paintEvent(QPaintEvent *event)
     // 3) logo
     if (!m_logo.isNull()) {
         int w = (m_logo.width() * m_logoHeight) / std::max(1, m_logo.height());
-        QRect r(m_logoMargin, height() - m_logoMargin - m_logoHeight, w, m_logoHeight);
+        QRect r(m_logoMargin, H - m_logoMargin - m_logoHeight, w, m_logoHeight);
         p.drawPixmap(r, m_logo);
     }
 
+}
+
+void MyLabel::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    QElapsedTimer t;
+    t.start();
+
+    QImage frame(size(), PixelFormat::composite());
+    frame.fill(0);
+
+    QPainter p(&frame);
+    renderComposite(p, frame.size());
+    p.end();
+    PixelFormat::countFrame();
+
+    quint64 seq;
     {
         QMutexLocker lk(&m_compMtx);
         m_lastComposite = frame;
+        seq = ++m_compositeSeq;
     }
+    emit compositeReady(seq);
 
     // draw to screen
     QPainter w(this);
     w.drawImage(QRect(QPoint(0,0), size()), frame);
+    w.end();
+
+    m_sched.frameRendered(t.nsecsElapsed(), false);
 }
 
+void MyLabel::setFramebuffer(FbOutput* fb)
+{
+    m_fb = fb;
+    requestFrame();
+}
+
+// Sources only mark the scene dirty; the scheduler decides when to draw.
+void MyLabel::requestFrame()
+{
+    m_sched.markDirty();
+}
+
+void MyLabel::onFrameDue()
+{
+    if (m_fb) renderToFramebuffer();
+    else update();
+}
+
+void MyLabel::renderToFramebuffer()
+{
+    if (!m_fb || !m_fb->isOpen()) return;
+
+    QElapsedTimer t;
+    t.start();
+
+    QImage& back = m_fb->backBuffer();
+    QPainter p(&back);
+    renderComposite(p, back.size());
+    p.end();
+    PixelFormat::countFrame();
+
+    quint64 seq;
+    {
+        // back is a view of the mapped page, so the stream needs its own copy
+        QMutexLocker lk(&m_compMtx);
+        m_lastComposite = back.copy();
+        seq = ++m_compositeSeq;
+    }
+    emit compositeReady(seq);
+
+    qint64 renderNs = t.nsecsElapsed();
+    bool vsynced = m_fb->flip();
+    m_sched.frameRendered(renderNs, vsynced);
+}
+
+
 void MyLabel::setConfig(const AppCfg& cfg)
 {
     m_cfg = cfg;
-    update();
+    m_sched.setTargetFps(cfg.display.fps);
+    requestFrame();
 }
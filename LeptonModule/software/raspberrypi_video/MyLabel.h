@@ -9,6 +9,10 @@
 #include <QPaintEvent>
 #include <QMutex>
 #include "Config.h"
+#include "FrameScheduler.h"
+
+class FbOutput;
+class QPainter;
 
 class MyLabel : public QLabel {
   Q_OBJECT;
@@ -20,6 +24,18 @@ class MyLabel : public QLabel {
     void setLogo(const QString &path, int heightPx = 36, int marginPx = 6);
     void setConfig(const AppCfg& cfg);
     QImage getLastComposite() const;
+    // seq increases by one for every new composite
+    QImage getLastComposite(quint64* seq) const;
+    // latest source layers as received (thermal at sensor size, camera at capture size)
+    QImage getThermalImage() const;
+    QImage getCameraImage() const;
+    const FrameScheduler& scheduler() const { return m_sched; }
+    // headless output: render into fb pages instead of painting the widget
+    void setFramebuffer(FbOutput* fb);
+
+  signals:
+    // a new composite is available through getLastComposite()
+    void compositeReady(quint64 seq);
 
   public slots:
     void setImage(QImage);
@@ -29,6 +45,11 @@ class MyLabel : public QLabel {
     void paintEvent(QPaintEvent *event) override;
 
   private:
+    void renderComposite(QPainter& p, const QSize& sz);
+    void requestFrame();
+    void onFrameDue();
+    void renderToFramebuffer();
+
     QImage m_lastImage;     // thermal sensor
     QImage m_camImage;      // usb camera
     QPixmap m_logo;
@@ -37,6 +58,9 @@ class MyLabel : public QLabel {
     AppCfg m_cfg;
     mutable QMutex m_compMtx;
     QImage m_lastComposite;
+    quint64 m_compositeSeq = 0;
+    FbOutput* m_fb = nullptr;
+    FrameScheduler m_sched;
 };
 
 #endif
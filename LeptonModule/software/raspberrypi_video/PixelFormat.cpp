@@ -0,0 +1,79 @@
+#include "PixelFormat.h"
+
+#include <atomic>
+
+namespace PixelFormat {
+
+static std::atomic<int> s_composite{QImage::Format_RGB32};
+static std::atomic<quint64> s_conversions[SiteCount];
+static std::atomic<quint64> s_frames{0};
+
+static const char* siteName(int s)
+{
+    switch (s) {
+    case SiteCamera:    return "camera";
+    case SiteThermal:   return "thermal";
+    case SiteComposite: return "composite";
+    case SiteEncoder:   return "encoder";
+    }
+    return "?";
+}
+
+static const char* formatName(QImage::Format f)
+{
+    switch (f) {
+    case QImage::Format_RGB16:                 return "RGB16";
+    case QImage::Format_RGB32:                 return "RGB32";
+    case QImage::Format_RGBX8888:              return "RGBX8888";
+    case QImage::Format_ARGB32:                return "ARGB32";
+    case QImage::Format_ARGB32_Premultiplied:  return "ARGB32_Premultiplied";
+    case QImage::Format_RGB888:                return "RGB888";
+    case QImage::Format_Grayscale8:            return "Grayscale8";
+    default:                                   return "other";
+    }
+}
+
+QImage::Format composite()
+{
+    return (QImage::Format)s_composite.load();
+}
+
+void setComposite(QImage::Format f)
+{
+    s_composite = f;
+}
+
+QImage convert(const QImage& img, QImage::Format f, Site site)
+{
+    if (img.isNull() || img.format() == f) return img;
+    s_conversions[site]++;
+    return img.convertToFormat(f);
+}
+
+void countFrame()
+{
+    s_frames++;
+}
+
+QJsonObject statsJson()
+{
+    quint64 frames = s_frames.load();
+    quint64 total = 0;
+
+    QJsonObject sites;
+    for (int i = 0; i < SiteCount; i++) {
+        quint64 n = s_conversions[i].load();
+        sites[siteName(i)] = (double)n;
+        total += n;
+    }
+
+    QJsonObject o;
+    o["composite_format"] = formatName(composite());
+    o["overlay_format"] = formatName(Overlay);
+    o["frames"] = (double)frames;
+    o["conversions"] = sites;
+    o["conversions_per_frame"] = frames ? (double)total / frames : 0.0;
+    return o;
+}
+
+}
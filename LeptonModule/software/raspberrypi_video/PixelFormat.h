@@ -0,0 +1,39 @@
+#pragma once
+#include <QImage>
+#include <QJsonObject>
+
+// Pipeline-wide pixel format policy.
+//
+// The composite format is chosen once at startup from the display: the
+// framebuffer's native format in -fb mode, RGB32 for the Qt widget. The USB
+// camera converts YUYV straight into that format and the thermal layer is
+// produced as premultiplied ARGB with the black key already applied, so the
+// compositor and encoders never need a full-frame format pass.
+//
+// Any place that still has to convert goes through convert(), which counts
+// the pass per site; the counters are reported on /api/stats.
+namespace PixelFormat {
+
+enum Site {
+    SiteCamera = 0,
+    SiteThermal,
+    SiteComposite,
+    SiteEncoder,
+    SiteCount
+};
+
+// thermal overlay layer (alpha 0 where the palette gives pure black)
+const QImage::Format Overlay = QImage::Format_ARGB32_Premultiplied;
+
+QImage::Format composite();
+void setComposite(QImage::Format f);
+
+// convertToFormat() that records a conversion at site when formats differ
+QImage convert(const QImage& img, QImage::Format f, Site site);
+
+// called once per composited frame, for conversions-per-frame
+void countFrame();
+
+QJsonObject statsJson();
+
+}
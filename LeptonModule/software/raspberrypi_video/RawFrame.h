@@ -0,0 +1,44 @@
+#pragma once
+#include <QVector>
+#include <QByteArray>
+#include <QMetaType>
+#include <QtEndian>
+#include <cstring>
+
+// One unpacked Lepton frame: 14-bit counts (or TLinear centikelvin when
+// radiometry is enabled on the camera), row-major, width * height values.
+struct RawFrame {
+    QVector<quint16> px;
+    int width = 0;
+    int height = 0;
+    quint32 frameId = 0;
+    qint64 timestampUs = 0; // wall clock when the last segment arrived
+    bool frozen = false;    // FFC running or settling: keep out of statistics (not serialized)
+
+    bool isNull() const { return px.isEmpty(); }
+
+    // Wire format used by /raw (and its WebSocket variant), little-endian:
+    //   char[4] "LRAW", u16 width, u16 height, u32 frame id, u64 timestamp us,
+    //   then width * height u16 pixels.
+    static const int HeaderSize = 20;
+
+    QByteArray serialize() const
+    {
+        QByteArray out(HeaderSize + px.size() * 2, Qt::Uninitialized);
+        uchar* d = reinterpret_cast<uchar*>(out.data());
+        std::memcpy(d, "LRAW", 4);
+        qToLittleEndian<quint16>((quint16)width, d + 4);
+        qToLittleEndian<quint16>((quint16)height, d + 6);
+        qToLittleEndian<quint32>(frameId, d + 8);
+        qToLittleEndian<quint64>((quint64)timestampUs, d + 12);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        std::memcpy(d + HeaderSize, px.constData(), px.size() * 2);
+#else
+        for (int i = 0; i < px.size(); ++i)
+            qToLittleEndian<quint16>(px[i], d + HeaderSize + 2 * i);
+#endif
+        return out;
+    }
+};
+
+Q_DECLARE_METATYPE(RawFrame)
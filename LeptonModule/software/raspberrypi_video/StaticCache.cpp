@@ -0,0 +1,139 @@
+#include "StaticCache.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QCryptographicHash>
+
+#include <zlib.h>
+
+static QByteArray mimeFor(const QString& fn)
+{
+    QString f = fn.toLower();
+    if (f.endsWith(".html")) return "text/html; charset=utf-8";
+    if (f.endsWith(".css"))  return "text/css; charset=utf-8";
+    if (f.endsWith(".js"))   return "application/javascript; charset=utf-8";
+    if (f.endsWith(".png"))  return "image/png";
+    if (f.endsWith(".jpg") || f.endsWith(".jpeg")) return "image/jpeg";
+    if (f.endsWith(".svg"))  return "image/svg+xml";
+    return "application/octet-stream";
+}
+
+static bool compressible(const QByteArray& contentType)
+{
+    return contentType.startsWith("text/") || contentType.startsWith("application/javascript")
+        || contentType.startsWith("image/svg");
+}
+
+// gzip container (not zlib), as sent with Content-Encoding: gzip
+static QByteArray gzipCompress(const QByteArray& in)
+{
+    z_stream zs {};
+    if (deflateInit2(&zs, 9, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return QByteArray();
+
+    QByteArray out;
+    out.resize((int)deflateBound(&zs, in.size()) + 32);
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.constData()));
+    zs.avail_in = in.size();
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = out.size();
+    int rc = deflate(&zs, Z_FINISH);
+    out.resize(out.size() - (int)zs.avail_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END ? out : QByteArray();
+}
+
+StaticCache::StaticCache(const QString& root, QObject* parent)
+    : QObject(parent), m_root(QDir::cleanPath(root))
+{
+    m_watcher.setParent(this); // moves along with the cache
+
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, &StaticCache::onFileChanged);
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, &StaticCache::onDirChanged);
+    scanDir(m_root);
+}
+
+void StaticCache::scanDir(const QString& dir)
+{
+    m_watcher.addPath(dir);
+    QDirIterator it(dir, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        QString full = it.next();
+        if (it.fileInfo().isDir()) scanDir(full);
+        else loadFile(full);
+    }
+}
+
+void StaticCache::loadFile(const QString& full)
+{
+    QString rel = QDir(m_root).relativeFilePath(full);
+    QFile f(full);
+    if (!f.open(QIODevice::ReadOnly)) {
+        m_assets.remove(rel);
+        return;
+    }
+
+    Asset a;
+    a.body = f.readAll();
+    a.contentType = mimeFor(full);
+    a.etag = '"' + QCryptographicHash::hash(a.body, QCryptographicHash::Sha1).toHex().left(16) + '"';
+    if (compressible(a.contentType) && a.body.size() > 256) {
+        QByteArray gz = gzipCompress(a.body);
+        if (!gz.isEmpty() && gz.size() < a.body.size()) a.gzip = gz;
+    }
+    m_assets.insert(rel, a);
+
+    // editors often replace files (new inode), which drops the watch
+    if (!m_watcher.files().contains(full)) m_watcher.addPath(full);
+}
+
+void StaticCache::onFileChanged(const QString& full)
+{
+    if (QFileInfo::exists(full)) {
+        loadFile(full);
+    } else {
+        m_assets.remove(QDir(m_root).relativeFilePath(full));
+        m_watcher.removePath(full);
+    }
+}
+
+void StaticCache::onDirChanged(const QString& dir)
+{
+    // new, removed or renamed entries: pick up anything not cached yet
+    QDirIterator it(dir, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        QString full = it.next();
+        if (it.fileInfo().isDir()) {
+            if (!m_watcher.directories().contains(full)) scanDir(full);
+        } else if (!m_assets.contains(QDir(m_root).relativeFilePath(full))) {
+            loadFile(full);
+        }
+    }
+    for (auto it2 = m_assets.begin(); it2 != m_assets.end();) {
+        if (!QFileInfo::exists(QDir(m_root).filePath(it2.key()))) it2 = m_assets.erase(it2);
+        else ++it2;
+    }
+}
+
+const StaticCache::Asset* StaticCache::find(const QByteArray& urlPath) const
+{
+    QString p = QString::fromUtf8(QByteArray::fromPercentEncoding(urlPath));
+    if (p == "/" || p.isEmpty()) p = "/index.html";
+    if (p.startsWith("/")) p = p.mid(1);
+
+    // prevent traversal
+    p = QDir::cleanPath(p);
+    if (p.startsWith("..")) return nullptr;
+
+    auto it = m_assets.constFind(p);
+    return it == m_assets.constEnd() ? nullptr : &it.value();
+}
+
+qint64 StaticCache::bytes() const
+{
+    qint64 n = 0;
+    for (const Asset& a : m_assets) n += a.body.size() + a.gzip.size();
+    return n;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QFileSystemWatcher>
+
+// In-memory copy of webapp/. Every file is read once, with a gzip variant
+// (kept only when it is actually smaller) and a content ETag computed up
+// front. QFileSystemWatcher (inotify on Linux) reloads files that change
+// on disk, so edits show up without a restart.
+class StaticCache : public QObject {
+    Q_OBJECT
+public:
+    struct Asset {
+        QByteArray body;
+        QByteArray gzip;        // empty when compression does not pay off
+        QByteArray etag;        // quoted, strong
+        QByteArray contentType;
+    };
+
+    explicit StaticCache(const QString& root, QObject* parent = nullptr);
+
+    // urlPath is the request path ("/" maps to /index.html); null if missing
+    const Asset* find(const QByteArray& urlPath) const;
+
+    int count() const { return m_assets.size(); }
+    qint64 bytes() const;
+
+private:
+    void scanDir(const QString& dir);
+    void loadFile(const QString& full);
+    void onFileChanged(const QString& full);
+    void onDirChanged(const QString& dir);
+
+    QString m_root;
+    QHash<QString, Asset> m_assets;   // key: path relative to root
+    QFileSystemWatcher m_watcher;
+};
@@ -0,0 +1,215 @@
+#include "ToneMapper.h"
+
+#include <algorithm>
+#include <cstring>
+
+void ToneMapper::setPlateau(double percent)
+{
+    m_plateau = std::max(0.01, std::min(100.0, percent));
+}
+
+void ToneMapper::setClipLimit(double factor)
+{
+    m_clip = std::max(1.0, std::min(64.0, factor));
+}
+
+void ToneMapper::setTiles(int tilesX, int tilesY)
+{
+    m_tilesX = std::max(1, std::min(16, tilesX));
+    m_tilesY = std::max(1, std::min(16, tilesY));
+}
+
+void ToneMapper::begin()
+{
+    // add() only touched [min, max] of the last frame
+    if (m_min <= m_max) std::fill(&m_fine[m_min], &m_fine[m_max] + 1, 0);
+    m_min = 0xffff;
+    m_max = 0;
+}
+
+// Smallest shift that fits [min, max] into the given number of bins.
+int ToneMapper::binShift(int bins) const
+{
+    int shift = 0;
+    while (((m_max - m_min) >> shift) >= bins) shift++;
+    return shift;
+}
+
+void ToneMapper::map(const uint16_t* px, int w, int h, uint8_t* out)
+{
+    const int n = w * h;
+    if (m_min > m_max) {
+        memset(out, 0, n);
+        return;
+    }
+    if (m_mode == Clahe) mapClahe(px, w, h, out);
+    else mapGlobal(px, n, out, m_mode == Plateau);
+}
+
+void ToneMapper::mapGlobal(const uint16_t* px, int n, uint8_t* out, bool plateau)
+{
+    const int shift = binShift(HistBins);
+    const int bins = ((m_max - m_min) >> shift) + 1;
+    const uint16_t lo = m_min;
+    if ((int)m_hist.size() < bins) {
+        m_hist.resize(HistBins);
+        m_lut.resize(HistBins);
+    }
+    uint32_t* hist = m_hist.data();
+    uint8_t* lut = m_lut.data();
+    std::fill(hist, hist + bins, 0);
+
+    // fold the per-count histogram add() built into the mapping bins
+    uint32_t valid = 0;
+    const uint32_t* fine = &m_fine[lo];
+    for (int v = 0; v <= m_max - lo; ++v) {
+        hist[v >> shift] += fine[v];
+        valid += fine[v];
+    }
+
+    if (plateau) {
+        uint32_t cap = std::max<uint32_t>(1, (uint32_t)(valid * m_plateau / 100.0));
+        valid = 0;
+        for (int b = 0; b < bins; ++b) {
+            if (hist[b] > cap) hist[b] = cap;
+            valid += hist[b];
+        }
+    }
+
+    // mid-rank CDF: a bin maps to the centre of the output span it covers
+    uint32_t cum = 0;
+    for (int b = 0; b < bins; ++b) {
+        lut[b] = (uint8_t)((255u * (2 * cum + hist[b])) / (2 * valid));
+        cum += hist[b];
+    }
+
+    const uint16_t hi = m_max;
+    for (int i = 0; i < n; ++i) {
+        uint16_t v = px[i];
+        // pixels that did not go through add() are clamped into range
+        out[i] = v ? lut[(std::min(std::max(v, lo), hi) - lo) >> shift] : 0;
+    }
+}
+
+void ToneMapper::mapClahe(const uint16_t* px, int w, int h, uint8_t* out)
+{
+    const int tx = std::max(1, std::min(m_tilesX, w / 8));
+    const int ty = std::max(1, std::min(m_tilesY, h / 8));
+    const int shift = binShift(TileBins);
+    const int bins = ((m_max - m_min) >> shift) + 1;
+    const uint16_t lo = m_min, hi = m_max;
+    m_hist.resize(std::max<size_t>(m_hist.size(), (size_t)tx * ty * TileBins));
+    m_lut.resize(m_hist.size());
+
+    // clipped, redistributed histogram and CDF per tile
+    for (int j = 0; j < ty; ++j) {
+        const int y0 = j * h / ty, y1 = (j + 1) * h / ty;
+        for (int i = 0; i < tx; ++i) {
+            const int x0 = i * w / tx, x1 = (i + 1) * w / tx;
+            uint32_t* hist = &m_hist[(j * tx + i) * TileBins];
+            uint8_t* lut = &m_lut[(j * tx + i) * TileBins];
+            std::fill(hist, hist + bins, 0);
+
+            uint32_t valid = 0;
+            int bmin = bins, bmax = -1;
+            for (int y = y0; y < y1; ++y) {
+                const uint16_t* row = px + y * w;
+                for (int x = x0; x < x1; ++x) {
+                    uint16_t v = row[x];
+                    if (v == 0) continue;
+                    int b = (std::min(std::max(v, lo), hi) - lo) >> shift;
+                    hist[b]++;
+                    bmin = std::min(bmin, b);
+                    bmax = std::max(bmax, b);
+                    valid++;
+                }
+            }
+            if (valid == 0) {
+                std::fill(lut, lut + bins, 0);
+                continue;
+            }
+
+            // the clip limit and the redistribution only span the tile's own
+            // range; the global one can be far wider than a quiet tile
+            const int span = bmax - bmin + 1;
+            uint32_t limit = std::max<uint32_t>(1, (uint32_t)(m_clip * valid / span));
+            uint32_t excess = 0;
+            for (int b = bmin; b <= bmax; ++b) {
+                if (hist[b] > limit) {
+                    excess += hist[b] - limit;
+                    hist[b] = limit;
+                }
+            }
+            const uint32_t add = excess / span;
+            uint32_t total = 0;
+            for (int b = bmin; b <= bmax; ++b) {
+                hist[b] += add;
+                total += hist[b];
+            }
+
+            // bins outside the tile's range come out as 0 or 255, they are
+            // only reached by neighbouring tiles' pixels through the blend
+            uint32_t cum = 0;
+            for (int b = 0; b < bins; ++b) {
+                lut[b] = (uint8_t)((255u * (2 * cum + hist[b])) / (2 * total));
+                cum += hist[b];
+            }
+        }
+    }
+
+    // per column: tile to the left of the pixel and the weight (0..256) of
+    // the one to its right, both measured from tile centres
+    m_xTile.resize(w);
+    m_xWeight.resize(w);
+    for (int x = 0; x < w; ++x) {
+        int t = 0, wt = 0;
+        for (int i = tx - 1; i >= 0; --i) {
+            int c = (i * w / tx + (i + 1) * w / tx) / 2;
+            if (x >= c) {
+                t = i;
+                if (i + 1 < tx) {
+                    int c1 = ((i + 1) * w / tx + (i + 2) * w / tx) / 2;
+                    wt = (x - c) * 256 / (c1 - c);
+                }
+                break;
+            }
+        }
+        m_xTile[x] = t;
+        m_xWeight[x] = wt;
+    }
+
+    for (int y = 0; y < h; ++y) {
+        int ta = 0, wy = 0;
+        for (int j = ty - 1; j >= 0; --j) {
+            int c = (j * h / ty + (j + 1) * h / ty) / 2;
+            if (y >= c) {
+                ta = j;
+                if (j + 1 < ty) {
+                    int c1 = ((j + 1) * h / ty + (j + 2) * h / ty) / 2;
+                    wy = (y - c) * 256 / (c1 - c);
+                }
+                break;
+            }
+        }
+        const int tb = std::min(ta + 1, ty - 1);
+        const uint8_t* lutA = &m_lut[ta * tx * TileBins];
+        const uint8_t* lutB = &m_lut[tb * tx * TileBins];
+        const uint16_t* row = px + y * w;
+        uint8_t* dst = out + y * w;
+
+        for (int x = 0; x < w; ++x) {
+            uint16_t v = row[x];
+            if (v == 0) {
+                dst[x] = 0;
+                continue;
+            }
+            const int b = (std::min(std::max(v, lo), hi) - lo) >> shift;
+            const int l = m_xTile[x] * TileBins + b;
+            const int r = std::min(m_xTile[x] + 1, tx - 1) * TileBins + b;
+            const int wx = m_xWeight[x];
+            int top = lutA[l] * (256 - wx) + lutA[r] * wx;
+            int bottom = lutB[l] * (256 - wx) + lutB[r] * wx;
+            dst[x] = (uint8_t)((top * (256 - wy) + bottom * wy + 32768) >> 16);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Maps a frame of 14-bit Lepton counts (or 16-bit TLinear) to 8-bit palette
+// indices by histogram equalization, so a small hot object no longer
+// squeezes the rest of the scene into a few palette entries.
+//
+//   Heq      global equalization
+//   Plateau  global, each histogram bin capped at a share of the pixels so
+//            a large uniform background cannot take most of the range
+//   Clahe    per-tile clipped equalization, bilinearly blended between
+//            tile centres, for local contrast
+//
+// The decoder feeds every pixel to add() while it unpacks the frame, which
+// keeps the frame's min/max and, for the global modes, a full-resolution
+// histogram; map() then needs one pass over the pixels to write the
+// indices. Only the touched span of that histogram is integrated and
+// cleared, folded into at most HistBins bins over [min, max], so the cost
+// does not depend on the sensor's full range. CLAHE builds its tile
+// histograms in map(), they depend on where a pixel sits. 0 counts as
+// "no data" and maps to 0.
+class ToneMapper {
+public:
+    ToneMapper() : m_fine(65536) {}
+
+    enum Mode { Heq = 0, Plateau, Clahe };
+
+    void setMode(Mode mode) { m_mode = mode; }
+    Mode mode() const { return m_mode; }
+    // Plateau: max share of all pixels one bin may hold, in percent
+    void setPlateau(double percent);
+    // Clahe: clip limit as a multiple of a tile's mean bin count
+    void setClipLimit(double factor);
+    // Clahe: tile grid, clamped so tiles keep at least 8x8 pixels
+    void setTiles(int tilesX, int tilesY);
+
+    // per frame: begin(), add() for each non-zero pixel, then map()
+    void begin();
+    inline void add(uint16_t v)
+    {
+        if (v < m_min) m_min = v;
+        if (v > m_max) m_max = v;
+        if (m_mode != Clahe) m_fine[v]++;
+    }
+    void map(const uint16_t* px, int w, int h, uint8_t* out);
+
+    uint16_t lastMin() const { return m_min; }
+    uint16_t lastMax() const { return m_max; }
+
+    enum { HistBins = 4096, TileBins = 1024 };
+
+private:
+    int binShift(int bins) const;
+    void mapGlobal(const uint16_t* px, int n, uint8_t* out, bool plateau);
+    void mapClahe(const uint16_t* px, int w, int h, uint8_t* out);
+
+    Mode m_mode = Heq;
+    double m_plateau = 5.0;
+    double m_clip = 3.0;
+    int m_tilesX = 4, m_tilesY = 4;
+
+    uint16_t m_min = 0xffff, m_max = 0;
+    std::vector<uint32_t> m_fine;   // one bin per count, zero outside [min, max]
+    std::vector<uint32_t> m_hist;   // HistBins, or TileBins per tile
+    std::vector<uint8_t> m_lut;     // same layout as m_hist
+    std::vector<int> m_xTile;       // Clahe: per column left tile and weight
+    std::vector<int> m_xWeight;
+};
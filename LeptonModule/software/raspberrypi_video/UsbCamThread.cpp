@@ -1,4 +1,5 @@
 #include "UsbCamThread.h"
+#include "EdgeFilter.h"
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -12,24 +13,33 @@
 
 static inline uint8_t clamp8(int v) { return (uint8_t)std::min(255, std::max(0, v)); }
 
-// fast-ish YUYV -> RGB565
-static inline uint16_t yuv_to_rgb565(int y, int u, int v)
+static inline void yuv_to_rgb(int y, int u, int v, uint8_t &R, uint8_t &G, uint8_t &B)
 {
     int c = y - 16;
     int d = u - 128;
     int e = v - 128;
 
-    int r = (298 * c + 409 * e + 128) >> 8;
-    int g = (298 * c - 100 * d - 208 * e + 128) >> 8;
-    int b = (298 * c + 516 * d + 128) >> 8;
-
-    uint8_t R = clamp8(r);
-    uint8_t G = clamp8(g);
-    uint8_t B = clamp8(b);
+    R = clamp8((298 * c + 409 * e + 128) >> 8);
+    G = clamp8((298 * c - 100 * d - 208 * e + 128) >> 8);
+    B = clamp8((298 * c + 516 * d + 128) >> 8);
+}
 
+// fast-ish YUYV -> RGB565
+static inline uint16_t yuv_to_rgb565(int y, int u, int v)
+{
+    uint8_t R, G, B;
+    yuv_to_rgb(y, u, v, R, G, B);
     return (uint16_t)(((R & 0xF8) << 8) | ((G & 0xFC) << 3) | (B >> 3));
 }
 
+// YUYV -> RGB32 (0xffRRGGBB)
+static inline uint32_t yuv_to_rgb32(int y, int u, int v)
+{
+    uint8_t R, G, B;
+    yuv_to_rgb(y, u, v, R, G, B);
+    return 0xff000000u | ((uint32_t)R << 16) | ((uint32_t)G << 8) | B;
+}
+
 UsbCamThread::UsbCamThread(const QString &device, QObject *parent)
     : QThread(parent), m_dev(device)
 {
@@ -52,6 +62,24 @@ void UsbCamThread::setFps(int fps)
     m_fps = fps;
 }
 
+void UsbCamThread::setOutputFormat(QImage::Format f)
+{
+    m_format = (f == QImage::Format_RGB16) ? QImage::Format_RGB16 : QImage::Format_RGB32;
+}
+
+void UsbCamThread::setEmboss(bool enabled, int threshold, bool thin)
+{
+    m_embossThr = threshold;
+    m_embossThin = thin;
+    m_emboss = enabled;
+}
+
+void UsbCamThread::setEmbossSize(int w, int h)
+{
+    m_embossW = w;
+    m_embossH = h;
+}
+
 void UsbCamThread::run()
 {
     int fd = open(m_dev.toUtf8().constData(), O_RDWR | O_NONBLOCK, 0);
@@ -131,7 +159,10 @@ void UsbCamThread::run()
         return;
     }
 
-    QImage frame(m_w, m_h, QImage::Format_RGB16);
+    // converted straight into the composite format, so painting needs no extra pass
+    QImage frame(m_w, m_h, m_format);
+    QImage edges(m_w, m_h, QImage::Format_Grayscale8);
+    EdgeFilter edge;
 
     while (!m_stop) {
         v4l2_buffer b;
@@ -145,19 +176,48 @@ void UsbCamThread::run()
         }
 
         const uint8_t *src = (const uint8_t*)bufs[b.index].ptr;
-        uint16_t *dst = (uint16_t*)frame.bits();
+
+        if (m_emboss) {
+            // edges straight from the Y plane, no RGB conversion
+            int ew = m_embossW > 0 ? std::min<int>(m_embossW, m_w) : m_w;
+            int eh = m_embossH > 0 ? std::min<int>(m_embossH, m_h) : m_h;
+            if (edges.width() != ew || edges.height() != eh)
+                edges = QImage(ew, eh, QImage::Format_Grayscale8);
+
+            edge.setThreshold(m_embossThr);
+            edge.setThin(m_embossThin);
+            edge.processYuyv(src, m_w, m_h, m_w * 2, edges.bits(), edges.bytesPerLine(), ew, eh);
+            emit updateCamera(edges);
+            ioctl(fd, VIDIOC_QBUF, &b);
+            continue;
+        }
 
         // YUYV: Y0 U Y1 V
         int pixels = m_w * m_h;
-        for (int i = 0; i < pixels; i += 2) {
-            int y0 = src[0];
-            int u  = src[1];
-            int y1 = src[2];
-            int v  = src[3];
-            src += 4;
-
-            dst[i]     = yuv_to_rgb565(y0, u, v);
-            dst[i + 1] = yuv_to_rgb565(y1, u, v);
+        if (m_format == QImage::Format_RGB16) {
+            uint16_t *dst = (uint16_t*)frame.bits();
+            for (int i = 0; i < pixels; i += 2) {
+                int y0 = src[0];
+                int u  = src[1];
+                int y1 = src[2];
+                int v  = src[3];
+                src += 4;
+
+                dst[i]     = yuv_to_rgb565(y0, u, v);
+                dst[i + 1] = yuv_to_rgb565(y1, u, v);
+            }
+        } else {
+            uint32_t *dst = (uint32_t*)frame.bits();
+            for (int i = 0; i < pixels; i += 2) {
+                int y0 = src[0];
+                int u  = src[1];
+                int y1 = src[2];
+                int v  = src[3];
+                src += 4;
+
+                dst[i]     = yuv_to_rgb32(y0, u, v);
+                dst[i + 1] = yuv_to_rgb32(y1, u, v);
+            }
         }
 
         emit updateCamera(frame);
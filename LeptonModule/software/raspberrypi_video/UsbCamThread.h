@@ -4,6 +4,7 @@
 #include <QThread>
 #include <QImage>
 #include <QString>
+#include <atomic>
 
 class UsbCamThread : public QThread
 {
@@ -14,6 +15,12 @@ public:
 
     void setSize(int w, int h);
     void setFps(int fps);
+    // RGB16 or RGB32, normally PixelFormat::composite()
+    void setOutputFormat(QImage::Format f);
+    // emboss runs on the YUYV Y samples and emits Grayscale8 edges instead of RGB
+    void setEmboss(bool enabled, int threshold, bool thin);
+    // edge working resolution; 0 keeps the capture size
+    void setEmbossSize(int w, int h);
 
 signals:
     void updateCamera(QImage);
@@ -26,7 +33,13 @@ private:
     int m_w = 640;
     int m_h = 480;
     int m_fps = 15;
+    QImage::Format m_format = QImage::Format_RGB16;
     bool m_stop = false;
+    std::atomic<bool> m_emboss{false};
+    std::atomic<int> m_embossThr{35};
+    std::atomic<bool> m_embossThin{false};
+    std::atomic<int> m_embossW{0};
+    std::atomic<int> m_embossH{0};
 };
 
 #endif
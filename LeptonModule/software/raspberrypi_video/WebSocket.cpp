@@ -0,0 +1,93 @@
+#include "WebSocket.h"
+
+#include <QCryptographicHash>
+
+namespace WebSocket {
+
+QByteArray acceptKey(const QByteArray& clientKey)
+{
+    QByteArray k = clientKey.trimmed() + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    return QCryptographicHash::hash(k, QCryptographicHash::Sha1).toBase64();
+}
+
+QByteArray frame(Opcode op, const QByteArray& payload)
+{
+    const qint64 n = payload.size();
+    QByteArray out;
+    out.reserve(n + 10);
+    out += char(0x80 | op);
+    if (n < 126) {
+        out += char(n);
+    } else if (n <= 0xffff) {
+        out += char(126);
+        out += char((n >> 8) & 0xff);
+        out += char(n & 0xff);
+    } else {
+        out += char(127);
+        for (int i = 7; i >= 0; --i) out += char((n >> (8 * i)) & 0xff);
+    }
+    out += payload;
+    return out;
+}
+
+bool Parser::next(Opcode* op, QByteArray* payload)
+{
+    while (!m_error) {
+        if (m_buf.size() < 2) return false;
+        const uchar* b = reinterpret_cast<const uchar*>(m_buf.constData());
+
+        bool fin = b[0] & 0x80;
+        Opcode code = Opcode(b[0] & 0x0f);
+        bool masked = b[1] & 0x80;
+        quint64 len = b[1] & 0x7f;
+        int hdr = 2;
+        if (len == 126) {
+            if (m_buf.size() < 4) return false;
+            len = (quint64(b[2]) << 8) | b[3];
+            hdr = 4;
+        } else if (len == 127) {
+            if (m_buf.size() < 10) return false;
+            len = 0;
+            for (int i = 0; i < 8; ++i) len = (len << 8) | b[2 + i];
+            hdr = 10;
+        }
+
+        // clients must mask, and nothing they send us is large
+        if (!masked || len > (quint64)m_maxMessage) { m_error = true; return false; }
+        if (m_buf.size() < hdr + 4 + (qint64)len) return false;
+
+        const uchar* mask = b + hdr;
+        QByteArray data(m_buf.constData() + hdr + 4, (int)len);
+        for (int i = 0; i < (int)len; ++i) data[i] = char(data[i] ^ mask[i & 3]);
+        m_buf.remove(0, hdr + 4 + (int)len);
+
+        if (code & 0x8) {
+            // control frames are never fragmented and may interleave a message
+            if (!fin || len > 125) { m_error = true; return false; }
+            *op = code;
+            *payload = data;
+            return true;
+        }
+
+        if (code != Continuation) {
+            if (m_msgOp != Continuation) { m_error = true; return false; }
+            m_msgOp = code;
+            m_msg = data;
+        } else {
+            if (m_msgOp == Continuation) { m_error = true; return false; }
+            if (m_msg.size() + data.size() > m_maxMessage) { m_error = true; return false; }
+            m_msg += data;
+        }
+
+        if (fin) {
+            *op = m_msgOp;
+            *payload = m_msg;
+            m_msg.clear();
+            m_msgOp = Continuation;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
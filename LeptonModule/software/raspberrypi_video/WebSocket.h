@@ -0,0 +1,43 @@
+#pragma once
+#include <QByteArray>
+
+// Minimal RFC 6455 server side framing: handshake key, outgoing unmasked
+// frames and an incremental parser for masked client frames. Fragmented
+// messages are reassembled; control frames may arrive in between.
+namespace WebSocket {
+
+enum Opcode {
+    Continuation = 0x0,
+    Text         = 0x1,
+    Binary       = 0x2,
+    Close        = 0x8,
+    Ping         = 0x9,
+    Pong         = 0xA
+};
+
+// Sec-WebSocket-Accept for a client's Sec-WebSocket-Key
+QByteArray acceptKey(const QByteArray& clientKey);
+
+// One final, unmasked server frame
+QByteArray frame(Opcode op, const QByteArray& payload);
+
+class Parser {
+public:
+    explicit Parser(int maxMessage = 64 * 1024) : m_maxMessage(maxMessage) {}
+
+    void feed(const QByteArray& data) { m_buf += data; }
+
+    // Pops the next complete message (or control frame). Returns false when
+    // more data is needed; sets error() on protocol violations.
+    bool next(Opcode* op, QByteArray* payload);
+    bool error() const { return m_error; }
+
+private:
+    QByteArray m_buf;
+    QByteArray m_msg;           // fragments of a message in progress
+    Opcode m_msgOp = Continuation;
+    int m_maxMessage;
+    bool m_error = false;
+};
+
+}
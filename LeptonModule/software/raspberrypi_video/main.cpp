@@ -3,12 +3,38 @@
 #include <QWidget>
 #include <QCoreApplication>
 #include <QFileInfo>
+#include <QThread>
 #include "Config.h"
 #include "CmdServer.h"
 #include "MjpegServer.h"
 #include "LeptonThread.h"
 #include "UsbCamThread.h"
 #include "MyLabel.h"
+#include "Bench.h"
+#include "FbOutput.h"
+#include "PixelFormat.h"
+#include "CciWorker.h"
+#include "FfcController.h"
+#include "leptonSDKEmb32PUB/sim_I2C.h"
+
+// thermal.agc -> LeptonThread::setAgcPolicy (0 = tone map on the Pi)
+static int agcPolicy(const QString& agc)
+{
+        if (agc == "heq") return 2;
+        if (agc == "linear") return 1;
+        return 0;
+}
+
+// thermal.tone and the linear auto range tuning -> LeptonThread
+static void applyTone(LeptonThread *thread, const ThermalCfg& t)
+{
+        int mode = -1;
+        if (t.tone == "heq") mode = ToneMapper::Heq;
+        else if (t.tone == "plateau") mode = ToneMapper::Plateau;
+        else if (t.tone == "clahe") mode = ToneMapper::Clahe;
+        thread->setToneMapping(mode, t.tone_plateau, t.tone_clip);
+        thread->setAutoRangeTuning(t.range_clip, t.range_smooth, t.range_hysteresis);
+}
 
 int main(int argc, char **argv)
 {
@@ -18,6 +44,9 @@ int main(int argc, char **argv)
         int rangeMin = -1;
         int rangeMax = -1;
         int loglevel = 0;
+        const char *fbPath = nullptr;
+        int fbW = 640, fbH = 480, fbBpp = 16;
+        bool fbFake = false;
 
         for(int i=1; i < argc; i++) {
                 if ((strcmp(argv[i], "-cm") == 0) && (i + 1 != argc)) {
@@ -38,9 +67,37 @@ int main(int argc, char **argv)
                 } else if ((strcmp(argv[i], "-d") == 0) && (i + 1 != argc)) {
                         int val = std::atoi(argv[i + 1]);
                         if (0 <= val) { loglevel = val & 0xFF; i++; }
+                } else if ((strcmp(argv[i], "-fb") == 0) && (i + 1 != argc)) {
+                        // /dev/fbN, or with -fbmode a regular file as a fake framebuffer
+                        fbPath = argv[i + 1]; i++;
+                } else if ((strcmp(argv[i], "-fbmode") == 0) && (i + 1 != argc)) {
+                        // geometry of a fake framebuffer: WxH or WxHxBPP
+                        sscanf(argv[i + 1], "%dx%dx%d", &fbW, &fbH, &fbBpp); i++;
+                        fbFake = true;
+                } else if (strcmp(argv[i], "-simcci") == 0) {
+                        // CCI commands go to the in-process simulator, not /dev/i2c-1
+                        DEV_I2C_SetBackend(SIM_I2C_GetBackend());
+                } else if ((strcmp(argv[i], "-bench") == 0) && (i + 1 != argc)) {
+                        return runBench(argv[i + 1]);
                 }
         }
 
+        FbOutput *fb = nullptr;
+        if (fbPath) {
+            fb = new FbOutput;
+            if (fb->open(fbPath, fbFake, fbW, fbH, fbBpp)) {
+                // the fb backend owns the display, keep Qt's linuxfb plugin off it
+                qputenv("QT_QPA_PLATFORM", "offscreen");
+            } else {
+                qDebug() << "framebuffer output unavailable, using widget";
+                delete fb;
+                fb = nullptr;
+            }
+        }
+
+        // one pixel format end to end: the display's native one
+        PixelFormat::setComposite(fb ? fb->format() : QImage::Format_RGB32);
+
         QApplication a(argc, argv);
 
         AppCfg cfg;
@@ -79,8 +136,30 @@ int main(int argc, char **argv)
         );
         layout->addWidget(myLabel);
         myLabel->setConfig(cfg);
-        static MjpegServer* http = nullptr;
-        http = new MjpegServer(myLabel, &cfg, 8080, w);
+        // network I/O, HTTP parsing and streaming run on their own thread so
+        // viewers cannot stall painting; frames are handed over via signals
+        // and MyLabel's locked getters
+        QThread *netThread = new QThread;
+        netThread->setObjectName("http");
+        // Lepton CCI (I2C) commands run here, never on the GUI or capture thread
+        CciWorker *cci = new CciWorker;
+        cci->start();
+        FfcController *ffc = new FfcController(cci);
+        ffc->setConfig(cfg.ffc);
+
+        MjpegServer *http = new MjpegServer(myLabel, cfg, 8080);
+        http->setCci(cci);
+        http->setFfc(ffc);
+        http->moveToThread(netThread);
+        QObject::connect(netThread, &QThread::started, http, &MjpegServer::start);
+        QObject::connect(netThread, &QThread::finished, http, &QObject::deleteLater);
+        QObject::connect(&a, &QCoreApplication::aboutToQuit, [netThread, cci]() {
+            netThread->quit();
+            netThread->wait();
+            cci->stop();
+            cci->wait();
+        });
+        netThread->start();
         qDebug() << "HTTP MJPEG on port 8080";
         CmdServer *cmd = new CmdServer(
             "/tmp/lepton_cmd",
@@ -96,10 +175,48 @@ int main(int argc, char **argv)
         thread->useLepton(typeLepton);
         thread->useSpiSpeedMhz(spiSpeed);
         thread->setAutomaticScalingRange();
+        thread->setCci(cci);
+        thread->setAgcPolicy(agcPolicy(cfg.thermal.agc));
+        if (cfg.thermal.video == "rgb888") thread->setVideoRgb888(true);
+        applyTone(thread, cfg.thermal);
+        ffc->setCapture(thread);
+
+        QObject::connect(cmd, &CmdServer::cciRequested, [cci, ffc](const QString& op) {
+            if (op == "ffc") ffc->requestFfc();
+            else if (op == "reboot") cci->reboot();
+        });
 
-        QObject::connect(cmd, &CmdServer::configChanged, [&cfg, myLabel, thread]() {
+       UsbCamThread *cam = new UsbCamThread(cfg.usb.device);
+       cam->setSize(cfg.usb.width, cfg.usb.height);
+       cam->setFps(cfg.usb.fps);
+       cam->setOutputFormat(PixelFormat::composite());
+       cam->setEmboss(cfg.usb.emboss, cfg.usb.emboss_threshold, cfg.usb.emboss_thin);
+       cam->setEmbossSize(cfg.usb.emboss_width, cfg.usb.emboss_height);
+
+        QString background = cfg.background;
+        QString agc = cfg.thermal.agc;
+        QString video = cfg.thermal.video;
+        QObject::connect(cmd, &CmdServer::configChanged, [&cfg, myLabel, thread, cam, http, ffc, background, agc, video]() mutable {
             myLabel->setConfig(cfg);
-            thread->setBackgroundMode(cfg.background);
+            AppCfg copy = cfg;
+            QMetaObject::invokeMethod(http, [http, copy]() { http->setConfig(copy); },
+                                      Qt::QueuedConnection);
+            if (cfg.background != background) {
+                background = cfg.background;
+                thread->setBackgroundMode(background);
+            }
+            if (cfg.thermal.agc != agc) {
+                agc = cfg.thermal.agc;
+                thread->setAgcPolicy(agcPolicy(agc));
+            }
+            applyTone(thread, cfg.thermal);
+            if (cfg.thermal.video != video) {
+                video = cfg.thermal.video;
+                thread->setVideoRgb888(video == "rgb888");
+            }
+            cam->setEmboss(cfg.usb.emboss, cfg.usb.emboss_threshold, cfg.usb.emboss_thin);
+            cam->setEmbossSize(cfg.usb.emboss_width, cfg.usb.emboss_height);
+            ffc->setConfig(cfg.ffc);
         });
 
 
@@ -107,14 +224,16 @@ int main(int argc, char **argv)
         if (0 <= rangeMax) thread->useRangeMaxValue(rangeMax);
 
         QObject::connect(thread, SIGNAL(updateImage(QImage)), myLabel, SLOT(setImage(QImage)));
+        qRegisterMetaType<RawFrame>("RawFrame");
+        QObject::connect(thread, &LeptonThread::updateRaw, http, &MjpegServer::onRawFrame);
+        QObject::connect(thread, &LeptonThread::updateRaw, ffc, &FfcController::onRawFrame);
         thread->start();
 
-       UsbCamThread *cam = new UsbCamThread(cfg.usb.device);
-       cam->setSize(cfg.usb.width, cfg.usb.height);
-       cam->setFps(cfg.usb.fps);
         QObject::connect(cam, SIGNAL(updateCamera(QImage)), myLabel, SLOT(setCameraImage(QImage)));
         cam->start();
 
-        w->showFullScreen();
+        if (fb) myLabel->setFramebuffer(fb);
+        else w->showFullScreen();
+
         return a.exec();
 }
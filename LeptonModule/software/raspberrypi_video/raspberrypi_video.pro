@@ -25,6 +25,7 @@ HEADERS += *.h
 SOURCES += *.cpp
 
 unix:LIBS += -L$${RPI_LIBS}/$${LEPTONSDK}/Debug -lLEPTON_SDK
+unix:LIBS += -ljpeg -lz
 
 unix:QMAKE_CLEAN += -r $(OBJECTS_DIR) $${MOC_DIR}
 
@@ -7,6 +7,23 @@ var FlirCam = function () {
     _self.repeaters = {};
     _self.cfg = null;
 
+    // one WebSocket carries frames and commands; plain HTTP is the fallback
+    _self.ws = null;
+    _self.wsRetry = null;
+    _self.rawMode = false;
+    _self.frameUrl = null;
+    _self.palette = null;
+
+    _self.wsOpen = function () {
+        return _self.ws && _self.ws.readyState === 1;
+    };
+
+    _self.wsSend = function (obj) {
+        if (!_self.wsOpen()) return false;
+        _self.ws.send(JSON.stringify(obj));
+        return true;
+    };
+
     _self.apiGet = function (url, cb) {
         $.getJSON(url, function (d) {
             if (cb) cb(d);
@@ -14,16 +31,126 @@ var FlirCam = function () {
     };
 
     _self.apiCmd = function (line) {
+        if (_self.wsSend({ cmd: line })) return;
         $.getJSON("/api/cmd?line=" + encodeURIComponent(line));
     };
 
     _self.loadConfig = function () {
+        if (_self.wsSend({ get: "config" })) return;
         _self.apiGet("/api/config", function (cfg) {
             _self.cfg = cfg;
             _self.applyConfigToUI();
         });
     };
 
+    _self.connect = function () {
+        if (_self.wsRetry) { clearTimeout(_self.wsRetry); _self.wsRetry = null; }
+        if (_self.ws) { _self.ws.onclose = null; _self.ws.close(); _self.ws = null; }
+
+        if (!window.WebSocket) {
+            $("#stream").attr("src", "/mjpeg?ts=" + Date.now());
+            return;
+        }
+
+        var proto = (window.location.protocol === "https:") ? "wss://" : "ws://";
+        var ws = new WebSocket(proto + window.location.host + "/ws");
+        ws.binaryType = "arraybuffer";
+        _self.ws = ws;
+
+        ws.onopen = function () {
+            $("#stream").attr("src", "");
+            _self.wsSend({ stream: _self.rawMode ? "raw" : "mjpeg" });
+            _self.loadConfig();
+        };
+
+        ws.onmessage = function (ev) {
+            if (typeof ev.data === "string") {
+                var msg = JSON.parse(ev.data);
+                if (msg.type === "config") {
+                    _self.cfg = msg.data;
+                    _self.applyConfigToUI();
+                }
+                return;
+            }
+            _self.showFrame(ev.data);
+        };
+
+        ws.onclose = function () {
+            // keep a picture on screen while we try to get the socket back
+            if (!_self.rawMode) $("#stream").attr("src", "/mjpeg?ts=" + Date.now());
+            if (!_self.cfg) _self.loadConfig();
+            _self.wsRetry = setTimeout(_self.connect, 2000);
+        };
+    };
+
+    _self.showFrame = function (buf) {
+        var b = new Uint8Array(buf, 0, 4);
+        if (b[0] === 0xff && b[1] === 0xd8) {
+            if (_self.frameUrl) URL.revokeObjectURL(_self.frameUrl);
+            _self.frameUrl = URL.createObjectURL(new Blob([buf], { type: "image/jpeg" }));
+            $("#stream").attr("src", _self.frameUrl);
+        } else if (b[0] === 0x4c && b[1] === 0x52 && b[2] === 0x41 && b[3] === 0x57) {
+            _self.drawRaw(buf);
+        }
+    };
+
+    // ironbow-like 256 entry palette, built from a few color stops
+    _self.buildPalette = function () {
+        var stops = [
+            [0, 0, 0, 0], [0.2, 32, 0, 140], [0.45, 204, 0, 119],
+            [0.7, 255, 140, 0], [0.9, 255, 230, 50], [1, 255, 255, 255]
+        ];
+        var p = new Uint8Array(256 * 3);
+        for (var i = 0; i < 256; i++) {
+            var t = i / 255, k = 1;
+            while (k < stops.length - 1 && stops[k][0] < t) k++;
+            var a = stops[k - 1], c = stops[k];
+            var f = (t - a[0]) / (c[0] - a[0]);
+            for (var j = 0; j < 3; j++) p[i * 3 + j] = Math.round(a[j + 1] + (c[j + 1] - a[j + 1]) * f);
+        }
+        return p;
+    };
+
+    // LRAW: "LRAW", u16 w, u16 h, u32 frame, u64 ts_us, w*h u16 (little-endian)
+    _self.drawRaw = function (buf) {
+        var dv = new DataView(buf);
+        var w = dv.getUint16(4, true), h = dv.getUint16(6, true);
+        var px = new Uint16Array(buf.slice(20, 20 + w * h * 2));
+
+        var lo = 65535, hi = 0, i;
+        for (i = 0; i < px.length; i++) {
+            var v = px[i];
+            if (v === 0) continue;
+            if (v < lo) lo = v;
+            if (v > hi) hi = v;
+        }
+        var span = Math.max(1, hi - lo);
+
+        var canvas = document.getElementById("raw_canvas");
+        if (canvas.width !== w || canvas.height !== h) {
+            canvas.width = w;
+            canvas.height = h;
+        }
+        var ctx = canvas.getContext("2d");
+        var img = ctx.createImageData(w, h);
+        var pal = _self.palette || (_self.palette = _self.buildPalette());
+        for (i = 0; i < px.length; i++) {
+            var idx = Math.max(0, Math.min(255, ((px[i] - lo) * 255 / span) | 0)) * 3;
+            img.data[i * 4] = pal[idx];
+            img.data[i * 4 + 1] = pal[idx + 1];
+            img.data[i * 4 + 2] = pal[idx + 2];
+            img.data[i * 4 + 3] = 255;
+        }
+        ctx.putImageData(img, 0, 0);
+    };
+
+    _self.setRawMode = function (on) {
+        _self.rawMode = on;
+        $("#stream").toggle(!on);
+        $("#raw_canvas").toggle(on);
+        _self.wsSend({ stream: on ? "raw" : "mjpeg" });
+    };
+
     _self.applyConfigToUI = function () {
         var c = _self.cfg;
         if (!c) return;
@@ -33,6 +160,7 @@ var FlirCam = function () {
         $("#thermal_enabled").prop("checked", c.thermal.enabled);
         $("#thermal_smooth").val(c.thermal.smooth);
         $("#thermal_smooth_val").text(c.thermal.smooth);
+        $("#thermal_agc").val(c.thermal.agc || "pi");
 
         $("#th_offx").val(c.thermal.offset_x);
         $("#th_offy").val(c.thermal.offset_y);
@@ -42,6 +170,8 @@ var FlirCam = function () {
 
         $("#cam_enabled").prop("checked", c.usb_cam.enabled);
         $("#cam_emboss").prop("checked", c.usb_cam.emboss);
+        $("#cam_emboss_thin").prop("checked", c.usb_cam.emboss_thin);
+        $("#cam_edge_thr").val(c.usb_cam.emboss_threshold);
 
         $("#cam_offx").val(c.usb_cam.offset_x);
         $("#cam_offy").val(c.usb_cam.offset_y);
@@ -76,7 +206,9 @@ var FlirCam = function () {
                 cam_offy:   { src: "usb", key: "offset_y" },
                 cam_scale:  { src: "usb", key: "scale" },
                 cam_opacity:{ src: "usb", key: "opacity" },
-                cam_rot:    { src: "usb", key: "rotate_deg" }
+                cam_rot:    { src: "usb", key: "rotate_deg" },
+
+                cam_edge_thr: { src: "usb", key: "emboss_threshold" }
             };
 
             if (!map[id]) return;
@@ -92,18 +224,35 @@ var FlirCam = function () {
             _self.apiCmd("set thermal smooth " + this.value);
         });
 
+        $("body").on("change", "#thermal_agc", function () {
+            _self.apiCmd("set thermal agc " + this.value);
+        });
+
         $("body").on("change", "#cam_emboss", function () {
             _self.apiCmd("set usb emboss " + (this.checked ? "1" : "0"));
         });
 
+        $("body").on("change", "#cam_emboss_thin", function () {
+            _self.apiCmd("set usb emboss_thin " + (this.checked ? "1" : "0"));
+        });
+
+        $("body").on("change", "#raw_mode", function () {
+            _self.setRawMode(this.checked);
+        });
+
+        $("body").on("click", "#btn_ffc", function () {
+            _self.apiCmd("ffc");
+        });
+
         $("body").on("click", "#btn_reload", function () {
-            $("#stream").attr("src", "/mjpeg?ts=" + Date.now());
+            _self.connect();
         });
     };
 
     _self.init = function () {
         _self.handleEvents();
-        _self.loadConfig();
+        _self.connect();
+        if (!window.WebSocket) _self.loadConfig();
         console.log("FlirCam initialized");
     };
 };
@@ -81,6 +81,8 @@ apt-get install -y --no-install-recommends \
   qt5-qmake qtbase5-dev qtbase5-dev-tools \
   libqt5gui5 libqt5widgets5 libqt5core5a \
   libgles2-mesa-dev \
+  libjpeg-dev \
+  zlib1g-dev \
   ffmpeg \
   fbset
 
@@ -166,6 +168,7 @@ sudo -u "$TARGET_USER" sh -c "
   make distclean >/dev/null 2>&1 || true &&
   rm -f Makefile .qmake.stash &&
   rm -rf gen_objs gen_mocs &&
+  make -C ../raspberrypi_libs/leptonSDKEmb32PUB clean >/dev/null 2>&1 || true &&
   qmake &&
   make -j1
 "